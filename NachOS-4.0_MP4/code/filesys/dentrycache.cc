@@ -0,0 +1,268 @@
+// dentrycache.cc
+//	Routines to cache the results of directory lookups.  See
+//	dentrycache.h for what the cache holds.
+//
+//	Every entry is always on the LRU list; an entry in use is also on
+//	the hash chain for its (parent, name) pair.  An entry that is
+//	invalidated goes to the back of the LRU list, so it is the next
+//	one reused.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "dentrycache.h"
+#include "main.h"
+
+//----------------------------------------------------------------------
+// DentryCache::DentryCache
+// 	Initialize an empty path lookup cache.
+//----------------------------------------------------------------------
+
+DentryCache::DentryCache()
+{
+    entries = new Dentry[NumDentries];
+    for (int i = 0; i < DentryHashSize; i++)
+	hashTable[i] = NULL;
+    for (int i = 0; i < NumDentries; i++) {
+	entries[i].parent = -1;
+	entries[i].name[0] = '\0';
+	entries[i].hashNext = NULL;
+	entries[i].lruPrev = (i > 0) ? &entries[i - 1] : NULL;
+	entries[i].lruNext = (i < NumDentries - 1) ? &entries[i + 1] : NULL;
+    }
+    lruHead = &entries[0];
+    lruTail = &entries[NumDentries - 1];
+    generation = 0;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::~DentryCache
+// 	De-allocate the cache.
+//----------------------------------------------------------------------
+
+DentryCache::~DentryCache()
+{
+    delete [] entries;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Lookup
+// 	Return TRUE if the lookup of "name" in a directory is cached, and
+//	if so, its result: the sector of the file's header (-1 if there
+//	is no such file), and whether the file is a directory.
+//
+//	"parent" -- the sector of the directory's file header
+//	"name" -- the name to look up
+//----------------------------------------------------------------------
+
+bool
+DentryCache::Lookup(int parent, char *name, int *sector, bool *isDirectory)
+{
+    Dentry *d = Find(parent, name);
+
+    if (d == NULL) {
+	kernel->stats->numDentryMisses++;
+	return FALSE;
+    }
+    kernel->stats->numDentryHits++;
+    MoveToFront(d);
+    *sector = d->sector;
+    *isDirectory = d->isDirectory;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Enter
+// 	The file system has just created or removed "name" in a directory:
+//	remember what looking it up now finds, in place of any earlier
+//	result, and bump the generation, so that lookups already under way
+//	do not overwrite it with what they read before the change.
+//
+//	"parent" -- the sector of the directory's file header
+//	"name" -- the name created or removed
+//	"sector" -- the sector of the file's header, or -1 if removed
+//	"isDirectory" -- is the file a directory?
+//----------------------------------------------------------------------
+
+void
+DentryCache::Enter(int parent, char *name, int sector, bool isDirectory)
+{
+    generation++;
+    EnterLookup(parent, name, sector, isDirectory, generation);
+}
+
+//----------------------------------------------------------------------
+// DentryCache::EnterLookup
+// 	Remember the result of looking up "name" in a directory, in place
+//	of any earlier result, reusing the least recently used entry --
+//	unless the cache has changed since the lookup started (at
+//	generation "since"): the directory may have changed under it.
+//
+//	"parent" -- the sector of the directory's file header
+//	"name" -- the name looked up
+//	"sector" -- the sector of the file's header, or -1 if not found
+//	"isDirectory" -- is the file a directory?
+//	"since" -- Generation() before the directory was read
+//----------------------------------------------------------------------
+
+void
+DentryCache::EnterLookup(int parent, char *name, int sector,
+					bool isDirectory, int since)
+{
+    Dentry *d;
+
+    if (since != generation)
+	return;				// the answer may be out of date
+    if (strlen(name) > FileNameMaxLen)
+	return;				// cannot be in any directory
+    d = Find(parent, name);
+    if (d == NULL) {
+	d = lruTail;
+	if (d->parent != -1)
+	    HashRemove(d);
+	d->parent = parent;
+	strcpy(d->name, name);
+	int bucket = Hash(parent, name);
+	d->hashNext = hashTable[bucket];
+	hashTable[bucket] = d;
+    }
+    d->sector = sector;
+    d->isDirectory = isDirectory;
+    MoveToFront(d);
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Invalidate
+// 	Forget the lookup of "name" in a directory, if it is cached.
+//
+//	"parent" -- the sector of the directory's file header
+//	"name" -- the name whose directory entry changed
+//----------------------------------------------------------------------
+
+void
+DentryCache::Invalidate(int parent, char *name)
+{
+    Dentry *d = Find(parent, name);
+
+    generation++;
+    if (d != NULL) {
+	HashRemove(d);
+	MoveToBack(d);
+    }
+}
+
+//----------------------------------------------------------------------
+// DentryCache::InvalidateDirectory
+// 	Forget every lookup in a directory that was removed, since its
+//	header sector may be reused by another directory.
+//
+//	"parent" -- the sector of the directory's file header
+//----------------------------------------------------------------------
+
+void
+DentryCache::InvalidateDirectory(int parent)
+{
+    generation++;
+    for (int i = 0; i < NumDentries; i++)
+	if (entries[i].parent == parent) {
+	    HashRemove(&entries[i]);
+	    MoveToBack(&entries[i]);
+	}
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Find
+// 	Return the entry for looking up "name" in directory "parent", or
+//	NULL if there is none.
+//----------------------------------------------------------------------
+
+Dentry *
+DentryCache::Find(int parent, char *name)
+{
+    Dentry *d;
+
+    for (d = hashTable[Hash(parent, name)]; d != NULL; d = d->hashNext)
+	if (d->parent == parent && !strcmp(d->name, name))
+	    return d;
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Hash
+// 	Return the hash bucket for looking up "name" in directory "parent".
+//----------------------------------------------------------------------
+
+int
+DentryCache::Hash(int parent, char *name)
+{
+    unsigned int hash = 2166136261u ^ parent;
+
+    for (char *p = name; *p != '\0'; p++) {
+	hash ^= (unsigned char) *p;
+	hash *= 16777619u;
+    }
+    return hash % DentryHashSize;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::HashRemove
+// 	Take an entry off its hash chain, and mark it unused.
+//----------------------------------------------------------------------
+
+void
+DentryCache::HashRemove(Dentry *d)
+{
+    Dentry **p = &hashTable[Hash(d->parent, d->name)];
+
+    while (*p != d) {
+	ASSERT(*p != NULL);
+	p = &(*p)->hashNext;
+    }
+    *p = d->hashNext;
+    d->hashNext = NULL;
+    d->parent = -1;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::MoveToFront/MoveToBack
+// 	Make an entry the most recently used one, or the one to be
+//	reused next.
+//----------------------------------------------------------------------
+
+void
+DentryCache::MoveToFront(Dentry *d)
+{
+    if (d == lruHead)
+	return;
+    // unlink
+    d->lruPrev->lruNext = d->lruNext;
+    if (d->lruNext != NULL)
+	d->lruNext->lruPrev = d->lruPrev;
+    else
+	lruTail = d->lruPrev;
+    // put at the head
+    d->lruPrev = NULL;
+    d->lruNext = lruHead;
+    lruHead->lruPrev = d;
+    lruHead = d;
+}
+
+void
+DentryCache::MoveToBack(Dentry *d)
+{
+    if (d == lruTail)
+	return;
+    // unlink
+    d->lruNext->lruPrev = d->lruPrev;
+    if (d->lruPrev != NULL)
+	d->lruPrev->lruNext = d->lruNext;
+    else
+	lruHead = d->lruNext;
+    // put at the tail
+    d->lruNext = NULL;
+    d->lruPrev = lruTail;
+    lruTail->lruNext = d;
+    lruTail = d;
+}
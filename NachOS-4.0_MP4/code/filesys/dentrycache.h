@@ -0,0 +1,95 @@
+// dentrycache.h
+//	Data structures for the path lookup cache -- the results of
+//	recent directory lookups, so that resolving a path name does not
+//	have to read every directory along it.
+//
+//	Each entry maps a name within a directory (identified by the
+//	sector of the directory's file header) to the sector of the named
+//	file's header, and whether it is itself a directory.  Names that
+//	were looked up and not found are remembered as well, as negative
+//	entries, since creating a file always looks its name up first.
+//
+//	The file system keeps the cache up to date as it creates and
+//	removes files.  Each such change bumps the cache's generation, so
+//	that a lookup that had to read a directory (and so may have been
+//	preempted) can tell whether its answer is still good to keep.
+//
+//	We assume mutual exclusion is provided by the caller, as for
+//	Directory operations.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef DENTRYCACHE_H
+#define DENTRYCACHE_H
+
+#include "directory.h"
+
+#define NumDentries 		256	// lookups remembered
+#define DentryHashSize 		64	// number of hash buckets
+
+// The following class defines an entry of the path lookup cache.
+//
+// Internal data structures kept public so that DentryCache operations
+// can access them directly.
+
+class Dentry {
+  public:
+    int parent;				// Header sector of the directory,
+					//   or -1 if the entry is unused
+    char name[FileNameMaxLen + 1];	// Name within the directory
+    int sector;				// Header sector of the named file,
+					//   or -1 if there is no such file
+    bool isDirectory;			// Is the named file a directory?
+    Dentry *hashNext;			// Next entry in the same hash bucket
+    Dentry *lruPrev;			// Neighbors in the LRU list; the
+    Dentry *lruNext;			//   head is the most recently used
+};
+
+// The following class defines the path lookup cache, a fixed number of
+// entries replaced in least recently used order.
+
+class DentryCache {
+  public:
+    DentryCache();			// Initialize an empty cache
+    ~DentryCache();			// De-allocate the cache
+
+    bool Lookup(int parent, char *name, int *sector, bool *isDirectory);
+					// Return TRUE, and the result of
+					//  looking up "name" in directory
+					//  "parent", if it is cached
+    int Generation() { return generation; }
+					// Changes made to the cache so far
+    void Enter(int parent, char *name, int sector, bool isDirectory);
+					// The file system changed the entry
+					//  for "name" ("sector" is -1 if it
+					//  was removed)
+    void EnterLookup(int parent, char *name, int sector, bool isDirectory,
+		     int since);	// Remember the result of a lookup
+					//  ("sector" is -1 if not found),
+					//  unless there were changes since
+					//  generation "since"
+    void Invalidate(int parent, char *name);
+					// Forget the lookup of "name"
+    void InvalidateDirectory(int parent);
+					// Forget every lookup in directory
+					//  "parent", which was removed
+
+  private:
+    Dentry *entries;			// The entries themselves
+    Dentry *hashTable[DentryHashSize];	// Chains of entries in use
+    Dentry *lruHead;			// Most recently used entry
+    Dentry *lruTail;			// Least recently used entry
+    int generation;			// Bumped on every change
+
+    Dentry *Find(int parent, char *name);  // Entry for a lookup, or NULL
+    int Hash(int parent, char *name);	// Hash bucket for a lookup
+    void HashRemove(Dentry *d);		// Take an entry off its chain
+    void MoveToFront(Dentry *d);	// Make an entry most recently used
+    void MoveToBack(Dentry *d);		// Make an entry the next to reuse
+};
+
+#endif // DENTRYCACHE_H
@@ -1,22 +1,35 @@
-// directory.cc 
+// directory.cc
 //	Routines to manage a directory of file names.
 //
-//	The directory is a table of fixed length entries; each
+//	The directory is a hash table of variable length entries; each
 //	entry represents a single file, and contains the file name,
-//	and the location of the file header on disk.  The fixed size
-//	of each directory entry means that we have the restriction
-//	of a fixed maximum size for file names.
+//	and the location of the file header on disk.  An entry only
+//	takes as much space as its name needs, so names can be long
+//	without making every entry big.
 //
-//	The constructor initializes an empty directory of a certain size;
-//	we use ReadFrom/WriteBack to fetch the contents of the directory
-//	from disk, and to write back any modifications back to disk.
+//	On disk, the directory is a sequence of DirBlockSize blocks.
+//	Block 0 is a DirectoryHeader.  Blocks 1 to numBuckets are the
+//	hash buckets; a name is stored in the bucket it hashes to, or, if
+//	that is full, in an overflow block chained to it.  Overflow blocks
+//	are added at the end of the directory as they are needed.  Every
+//	block starts with a DirBlockHeader, and is followed by the entries
+//	packed one after the other.
 //
-//	Also, this implementation has the restriction that the size
-//	of the directory cannot expand.  In other words, once all the
-//	entries in the directory are used, no more files can be created.
+//	Since there are DirLoadFactor entries per bucket on average, and
+//	about twenty short entries fit in a block, looking up a name
+//	nearly always reads a single block.  When the directory gets
+//	fuller than that, or there are more overflow blocks than buckets
+//	(long names fill blocks up sooner), the number of buckets is
+//	doubled and every entry is stored again; the directory file grows
+//	to match.
+//
+//	The constructor initializes an empty directory; we use
+//	FetchFrom/WriteBack to attach the directory to its file on disk,
+//	and to write back any modifications.  Blocks are only read in
+//	when a lookup needs them.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
-// All rights reserved.  See copyright.h for copyright notice and limitation 
+// All rights reserved.  See copyright.h for copyright notice and limitation
 // of liability and disclaimer of warranty provisions.
 
 #include "copyright.h"
@@ -24,27 +37,72 @@
 #include "filehdr.h"
 #include "directory.h"
 #include "filesys.h"
+#include "dentrycache.h"
+#include "main.h"
+
+// The header in block 0 of a directory.
+
+class DirectoryHeader {
+  public:
+    int version;			// DirectoryVersion
+    int numBuckets;			// Number of hash buckets
+    int numEntries;			// Number of files in the directory
+    int numBlocks;			// Number of blocks in use, including
+					// this one and the overflow blocks
+};
+
+// The header at the start of every bucket or overflow block.
+
+class DirBlockHeader {
+  public:
+    int next;				// Next overflow block, or -1
+    int used;				// Bytes in use, including this header
+};
+
+// The fixed part of an entry in a block.  The name follows, without
+// its trailing '\0', and the entry is padded to a multiple of 4 bytes.
+
+class DirRecord {
+  public:
+    int sector;				// Location of the file header
+    short nameLength;			// Number of characters in the name
+    char isDirectory;			// Is the file a directory?
+    char unused;
+};
+
+//----------------------------------------------------------------------
+// RecordSize
+// 	Return the number of bytes an entry for a name of "nameLength"
+//	characters takes up in a block.
+//----------------------------------------------------------------------
+
+static int
+RecordSize(int nameLength)
+{
+    return (sizeof(DirRecord) + nameLength + 3) & ~3;
+}
 
 //----------------------------------------------------------------------
 // Directory::Directory
 // 	Initialize a directory; initially, the directory is completely
-//	empty.  If the disk is being formatted, an empty directory
-//	is all we need, but otherwise, we need to call FetchFrom in order
-//	to initialize it from disk.
-//
-//	"size" is the number of entries in the directory
+//	empty, with a single bucket.  If the disk is being formatted, an
+//	empty directory is all we need, but otherwise, we need to call
+//	FetchFrom in order to initialize it from disk.
 //----------------------------------------------------------------------
 
-Directory::Directory(int size)
+Directory::Directory()
 {
-    table = new DirectoryEntry[size];
-	
-	// MP4 mod tag
-	memset(table, 0, sizeof(DirectoryEntry) * size);  // dummy operation to keep valgrind happy
-	
-    tableSize = size;
-    for (int i = 0; i < tableSize; i++)
-	table[i].inUse = FALSE;
+    file = NULL;
+    maxBlocks = 0;
+    blocks = NULL;
+    dirty = NULL;
+
+    DirectoryHeader *header = (DirectoryHeader *) NewBlock(0);
+    header->version = DirectoryVersion;
+    header->numBuckets = 1;
+    header->numEntries = 0;
+    header->numBlocks = 2;
+    NewBlock(1);
 }
 
 //----------------------------------------------------------------------
@@ -53,26 +111,33 @@ Directory::Directory(int size)
 //----------------------------------------------------------------------
 
 Directory::~Directory()
-{ 
-    delete [] table;
-} 
+{
+    Discard();
+    delete [] blocks;
+    delete [] dirty;
+}
 
 //----------------------------------------------------------------------
 // Directory::FetchFrom
-// 	Read the contents of the directory from disk.
+// 	Attach the directory to its file on disk, dropping whatever was
+//	in memory.  Only the header block is read now.
 //
-//	"file" -- file containing the directory contents
+//	"file" -- file containing the directory contents; it must stay
+//	open while the directory is in use
 //----------------------------------------------------------------------
 
 void
 Directory::FetchFrom(OpenFile *file)
 {
-    (void) file->ReadAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+    Discard();
+    this->file = file;
+    ASSERT(((DirectoryHeader *) GetBlock(0))->version == DirectoryVersion);
 }
 
 //----------------------------------------------------------------------
 // Directory::WriteBack
-// 	Write any modifications to the directory back to disk
+// 	Write the blocks that were modified back to disk.  The file must
+//	be at least FileSize() bytes long.
 //
 //	"file" -- file to contain the new directory contents
 //----------------------------------------------------------------------
@@ -80,30 +145,172 @@ Directory::FetchFrom(OpenFile *file)
 void
 Directory::WriteBack(OpenFile *file)
 {
-    (void) file->WriteAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+    int numBlocks = ((DirectoryHeader *) GetBlock(0))->numBlocks;
+
+    ASSERT(file->Length() >= FileSize());
+    for (int i = 0; i < numBlocks && i < maxBlocks; i++)
+	if (dirty[i]) {
+	    (void) file->WriteAt(blocks[i], DirBlockSize, i * DirBlockSize);
+	    dirty[i] = FALSE;
+	}
+}
+
+//----------------------------------------------------------------------
+// Directory::FileSize
+// 	Return the number of bytes of disk the directory needs.  Adding
+//	a file may make it grow.
+//----------------------------------------------------------------------
+
+int
+Directory::FileSize()
+{
+    return ((DirectoryHeader *) GetBlock(0))->numBlocks * DirBlockSize;
 }
 
 //----------------------------------------------------------------------
-// Directory::FindIndex
-// 	Look up file name in directory, and return its location in the table of
-//	directory entries.  Return -1 if the name isn't in the directory.
+// Directory::GetBlock
+// 	Return the in-core copy of a block, reading it from the file if
+//	it is not in memory yet.
 //
-//	"name" -- the file name to look up
+//	"block" -- the number of the block within the directory
+//----------------------------------------------------------------------
+
+char *
+Directory::GetBlock(int block)
+{
+    MakeRoom(block);
+    if (blocks[block] == NULL) {
+	ASSERT(file != NULL);
+	blocks[block] = new char[DirBlockSize];
+	(void) file->ReadAt(blocks[block], DirBlockSize, block * DirBlockSize);
+    }
+    return blocks[block];
+}
+
+//----------------------------------------------------------------------
+// Directory::NewBlock
+// 	Return an in-core block, emptied and marked as needing to be
+//	written back, without reading it from disk.
+//
+//	"block" -- the number of the block within the directory
+//----------------------------------------------------------------------
+
+char *
+Directory::NewBlock(int block)
+{
+    DirBlockHeader *blockHeader;
+
+    MakeRoom(block);
+    if (blocks[block] == NULL)
+	blocks[block] = new char[DirBlockSize];
+    memset(blocks[block], 0, DirBlockSize);
+    blockHeader = (DirBlockHeader *) blocks[block];
+    blockHeader->next = -1;
+    blockHeader->used = sizeof(DirBlockHeader);
+    dirty[block] = TRUE;
+    return blocks[block];
+}
+
+//----------------------------------------------------------------------
+// Directory::MakeRoom
+// 	Grow the arrays of in-core blocks, if need be, so that they have
+//	a slot for "block".
+//----------------------------------------------------------------------
+
+void
+Directory::MakeRoom(int block)
+{
+    if (block < maxBlocks)
+	return;
+
+    int newMax = max(2 * maxBlocks, block + 1);
+    char **newBlocks = new char *[newMax];
+    bool *newDirty = new bool[newMax];
+
+    for (int i = 0; i < newMax; i++) {
+	newBlocks[i] = (i < maxBlocks) ? blocks[i] : NULL;
+	newDirty[i] = (i < maxBlocks) ? dirty[i] : FALSE;
+    }
+    delete [] blocks;
+    delete [] dirty;
+    blocks = newBlocks;
+    dirty = newDirty;
+    maxBlocks = newMax;
+}
+
+//----------------------------------------------------------------------
+// Directory::Discard
+// 	Throw away every block in memory, changed or not.
+//----------------------------------------------------------------------
+
+void
+Directory::Discard()
+{
+    for (int i = 0; i < maxBlocks; i++) {
+	delete [] blocks[i];
+	blocks[i] = NULL;
+	dirty[i] = FALSE;
+    }
+    file = NULL;
+}
+
+//----------------------------------------------------------------------
+// Directory::Bucket
+// 	Return the number of the bucket block for a file name, by hashing
+//	the name (FNV-1a).
+//
+//	"name" -- the file name
 //----------------------------------------------------------------------
 
 int
-Directory::FindIndex(char *name)
+Directory::Bucket(char *name)
+{
+    unsigned int hash = 2166136261u;
+    int numBuckets = ((DirectoryHeader *) GetBlock(0))->numBuckets;
+
+    for (char *p = name; *p != '\0'; p++) {
+	hash ^= (unsigned char) *p;
+	hash *= 16777619u;
+    }
+    return 1 + hash % numBuckets;
+}
+
+//----------------------------------------------------------------------
+// Directory::FindEntry
+// 	Look up file name in directory.  Return TRUE, and set "*block"
+//	and "*offset" to the location of its entry, if it is there.
+//
+//	"name" -- the file name to look up
+//----------------------------------------------------------------------
+
+bool
+Directory::FindEntry(char *name, int *block, int *offset)
 {
-    for (int i = 0; i < tableSize; i++)
-        if (table[i].inUse && !strncmp(table[i].name, name, FileNameMaxLen))
-	    return i;
-    return -1;		// name not in directory
+    int length = strlen(name);
+
+    for (int b = Bucket(name); b != -1; ) {
+	char *data = GetBlock(b);
+	DirBlockHeader *blockHeader = (DirBlockHeader *) data;
+
+	for (int i = sizeof(DirBlockHeader); i < blockHeader->used; ) {
+	    DirRecord *record = (DirRecord *) (data + i);
+	    if (record->nameLength == length
+		    && !strncmp(data + i + sizeof(DirRecord), name, length)) {
+		*block = b;
+		*offset = i;
+		return TRUE;
+	    }
+	    i += RecordSize(record->nameLength);
+	}
+	b = blockHeader->next;
+    }
+    return FALSE;		// name not in directory
 }
 
 //----------------------------------------------------------------------
 // Directory::Find
 // 	Look up file name in directory, and return the disk sector number
-//	where the file's header is stored. Return -1 if the name isn't 
+//	where the file's header is stored. Return -1 if the name isn't
 //	in the directory.
 //
 //	"name" -- the file name to look up
@@ -112,71 +319,223 @@ Directory::FindIndex(char *name)
 int
 Directory::Find(char *name)
 {
-    int i = FindIndex(name);
+    int sector;
+    bool isDirectory;
 
-    if (i != -1)
-	return table[i].sector;
+    if (Lookup(name, &sector, &isDirectory))
+	return sector;
     return -1;
 }
 
+//----------------------------------------------------------------------
+// Directory::Lookup
+// 	Look up file name in directory.  Return TRUE, along with the disk
+//	sector number of the file's header and whether the file is a
+//	directory, if it is there.
+//
+//	"name" -- the file name to look up
+//----------------------------------------------------------------------
+
+bool
+Directory::Lookup(char *name, int *sector, bool *isDirectory)
+{
+    int block, offset;
+    DirRecord *record;
+
+    if (!FindEntry(name, &block, &offset))
+	return FALSE;
+    record = (DirRecord *) (GetBlock(block) + offset);
+    *sector = record->sector;
+    *isDirectory = record->isDirectory;
+    return TRUE;
+}
+
 //----------------------------------------------------------------------
 // Directory::Add
 // 	Add a file into the directory.  Return TRUE if successful;
 //	return FALSE if the file name is already in the directory, or if
-//	the directory is completely full, and has no more space for
-//	additional file names.
+//	it is too long.  The directory grows as needed, so the caller
+//	must extend the directory file to FileSize() before WriteBack.
 //
 //	"name" -- the name of the file being added
 //	"newSector" -- the disk sector containing the added file's header
+//	"isDirectory" -- is the file a directory?
 //----------------------------------------------------------------------
 
 bool
 Directory::Add(char *name, int newSector, bool isDirectory)
-{ 
-    if (FindIndex(name) != -1)
+{
+    int block, offset;
+    DirectoryHeader *header = (DirectoryHeader *) GetBlock(0);
+
+    if (strlen(name) > FileNameMaxLen || FindEntry(name, &block, &offset))
 	return FALSE;
+    if (header->numEntries >= header->numBuckets * DirLoadFactor
+		|| header->numBlocks > 1 + 2 * header->numBuckets)
+	Grow();			// too many entries, or names too long
+				// for the buckets to hold them
+    Insert(name, newSector, isDirectory);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Directory::Insert
+// 	Store an entry for a name that is not in the directory, in the
+//	first block of its bucket's chain with room for it, adding an
+//	overflow block if none has.
+//
+//	"name" -- the name of the file being added
+//	"newSector" -- the disk sector containing the added file's header
+//	"isDirectory" -- is the file a directory?
+//----------------------------------------------------------------------
+
+void
+Directory::Insert(char *name, int newSector, bool isDirectory)
+{
+    DirectoryHeader *header = (DirectoryHeader *) GetBlock(0);
+    int length = strlen(name);
+    int size = RecordSize(length);
+    int b = Bucket(name);
 
-    for (int i = 0; i < tableSize; i++)
-        if (!table[i].inUse) {
-            table[i].inUse = TRUE;
-            strncpy(table[i].name, name, FileNameMaxLen); 
-            table[i].sector = newSector;
-			table[i].isDirectory = isDirectory;
-        return TRUE;
+    for (;;) {
+	char *data = GetBlock(b);
+	DirBlockHeader *blockHeader = (DirBlockHeader *) data;
+
+	if (blockHeader->used + size <= DirBlockSize) {
+	    DirRecord *record = (DirRecord *) (data + blockHeader->used);
+	    record->sector = newSector;
+	    record->nameLength = length;
+	    record->isDirectory = isDirectory;
+	    record->unused = 0;
+	    bcopy(name, data + blockHeader->used + sizeof(DirRecord), length);
+	    blockHeader->used += size;
+	    dirty[b] = TRUE;
+	    break;
+	}
+	if (blockHeader->next == -1) {	// chain a new overflow block
+	    blockHeader->next = header->numBlocks++;
+	    dirty[b] = TRUE;
+	    NewBlock(blockHeader->next);
 	}
-    return FALSE;	// no space.  Fix when we have extensible files.
+	b = blockHeader->next;
+    }
+    header->numEntries++;
+    dirty[0] = TRUE;
+}
+
+//----------------------------------------------------------------------
+// Directory::Grow
+// 	Double the number of buckets, and store every entry again.  The
+//	old overflow blocks are no longer needed; their space in the file
+//	is reused by the new buckets.
+//----------------------------------------------------------------------
+
+void
+Directory::Grow()
+{
+    DirectoryHeader *header = (DirectoryHeader *) GetBlock(0);
+    int numEntries = header->numEntries;
+    DirectoryEntry *entries = new DirectoryEntry[numEntries];
+    int position = 0;
+
+    for (int i = 0; i < numEntries; i++) {
+	bool found = NextEntry(&position, &entries[i]);
+	ASSERT(found);
+    }
+    DEBUG(dbgFile, "Growing directory to " << 2 * header->numBuckets
+					<< " buckets");
+
+    header->numBuckets *= 2;
+    header->numBlocks = 1 + header->numBuckets;
+    header->numEntries = 0;
+    dirty[0] = TRUE;
+    for (int i = 1; i < header->numBlocks; i++)
+	NewBlock(i);
+    for (int i = 0; i < numEntries; i++)
+	Insert(entries[i].name, entries[i].sector, entries[i].isDirectory);
+    delete [] entries;
 }
 
 //----------------------------------------------------------------------
 // Directory::Remove
 // 	Remove a file name from the directory.  Return TRUE if successful;
-//	return FALSE if the file isn't in the directory. 
+//	return FALSE if the file isn't in the directory.  The entries
+//	after it in its block are moved down to fill the gap.
 //
 //	"name" -- the file name to be removed
 //----------------------------------------------------------------------
 
 bool
 Directory::Remove(char *name)
-{ 
-    int i = FindIndex(name);
+{
+    int block, offset;
 
-    if (i == -1)
+    if (!FindEntry(name, &block, &offset))
 	return FALSE; 		// name not in directory
-    table[i].inUse = FALSE;
-    return TRUE;	
+
+    char *data = GetBlock(block);
+    DirBlockHeader *blockHeader = (DirBlockHeader *) data;
+    int size = RecordSize(((DirRecord *) (data + offset))->nameLength);
+
+    memmove(data + offset, data + offset + size,
+				blockHeader->used - offset - size);
+    blockHeader->used -= size;
+    memset(data + blockHeader->used, 0, size);
+    dirty[block] = TRUE;
+    ((DirectoryHeader *) GetBlock(0))->numEntries--;
+    dirty[0] = TRUE;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Directory::NextEntry
+// 	Copy out the next entry of the directory, in the order they are
+//	stored.  Return FALSE if there are no more.
+//
+//	"position" -- where to continue from; 0 to start at the first
+//	entry, and advanced past the entry returned
+//	"entry" -- where to copy the entry to
+//----------------------------------------------------------------------
+
+bool
+Directory::NextEntry(int *position, DirectoryEntry *entry)
+{
+    int numBlocks = ((DirectoryHeader *) GetBlock(0))->numBlocks;
+    int block = max(*position / DirBlockSize, 1);
+    int offset = max(*position % DirBlockSize, (int) sizeof(DirBlockHeader));
+
+    for (; block < numBlocks; block++, offset = sizeof(DirBlockHeader)) {
+	char *data = GetBlock(block);
+
+	if (offset < ((DirBlockHeader *) data)->used) {
+	    DirRecord *record = (DirRecord *) (data + offset);
+	    entry->inUse = TRUE;
+	    entry->isDirectory = record->isDirectory;
+	    entry->sector = record->sector;
+	    bcopy(data + offset + sizeof(DirRecord), entry->name,
+							record->nameLength);
+	    entry->name[record->nameLength] = '\0';
+	    *position = block * DirBlockSize + offset
+					+ RecordSize(record->nameLength);
+	    return TRUE;
+	}
+    }
+    return FALSE;
 }
 
 //----------------------------------------------------------------------
 // Directory::List
-// 	List all the file names in the directory. 
+// 	List all the file names in the directory.
 //----------------------------------------------------------------------
 
 void
 Directory::List()
 {
-   for (int i = 0; i < tableSize; i++)
-	if (table[i].inUse)
-	    printf("%s\n", table[i].name);
+    DirectoryEntry entry;
+    int position = 0;
+
+    while (NextEntry(&position, &entry))
+	printf("%s\n", entry.name);
 }
 
 //----------------------------------------------------------------------
@@ -187,66 +546,87 @@ Directory::List()
 
 void
 Directory::Print()
-{ 
+{
+    DirectoryHeader *header = (DirectoryHeader *) GetBlock(0);
     FileHeader *hdr = new FileHeader;
+    DirectoryEntry entry;
+    int position = 0;
 
-    printf("Directory contents:\n");
-    for (int i = 0; i < tableSize; i++)
-	if (table[i].inUse) {
-	    printf("Name: %s, Sector: %d\n", table[i].name, table[i].sector);
-	    hdr->FetchFrom(table[i].sector);
-	    hdr->Print();
-	}
+    printf("Directory contents (%d files, %d buckets, %d blocks):\n",
+		header->numEntries, header->numBuckets, header->numBlocks);
+    while (NextEntry(&position, &entry)) {
+	printf("Name: %s, Sector: %d\n", entry.name, entry.sector);
+	hdr->FetchFrom(entry.sector);
+	hdr->Print();
+    }
     printf("\n");
     delete hdr;
 }
 
+//----------------------------------------------------------------------
+// Directory::FindPath
+// 	Look up a full path name, starting from this directory, which
+//	must be the root; return the disk sector number of the header of
+//	the file it names, or -1 if there is no such file.  Each
+//	component of the path keeps its leading '/', since that is how
+//	names are stored.
+//
+//	Each component is looked up in the path lookup cache first; a
+//	directory along the path is only read in if the cache does not
+//	know the answer, and the answer is then added to the cache --
+//	unless a file was created or removed while the directory was
+//	being read, since the answer may predate that.
+//
+//	"name" -- the path to look up, such as "/t0/bb/f1"
+//----------------------------------------------------------------------
+
 int
 Directory::FindPath(char *name)
 {
-	
-	char rootPath[256];
-	char restPath[256];
-	
-	if (name[1] == '\0') {
-		return 1; // root, return directory sector
-	} else {
-		bool onelevel = true;
-		int split = 0;
-		for(int i = 1; name[i] != '\0'; i++){
-			if (name[i] == '/'){
-				strncpy(rootPath, name, i);
-				rootPath[i] = '\0';
-				onelevel = false;
-				split = i;
-				break;
-			}
-		}
-		if (onelevel) {
-			strcpy(rootPath, name);
-			strcat(rootPath, "\0");
-			return Find(rootPath);
-		} else {
-			int sector = Find(rootPath);
-			if(sector == -1) return -1;
-			Directory *directory = new Directory(DirectoryFileSize); // 9+1
-			OpenFile *directoryFile = new OpenFile(sector);
-			directory->FetchFrom(directoryFile);
-			/*for(int i = 0; name[split+i] != '\0'; i++)
-				restPath[i] = name[split+i];
-			*/
-			for(int i = 1; i < strlen(name); i++)
-			{
-				if(name[i] == '/')
-				{
-					for(int j = 0; j < strlen(name)-i+1; j++) restPath[j] = name[j+i];
-					break;
-				}
-			}
-			sector = directory->FindPath(restPath);
-			delete directory;
-			delete directoryFile;
-			return sector;
-		}		
+    char component[FileNameMaxLen + 1];
+    Directory *subDirectory = NULL;
+    OpenFile *subFile = NULL;
+    int sector = DirectorySector;	// "/" is the root
+    bool isDirectory = TRUE;
+    char *p = name;
+
+    while (*p == '/' && p[1] != '\0') {
+	char *end = p + 1;
+	while (*end != '\0' && *end != '/')
+	    end++;
+	if (end - p > FileNameMaxLen || !isDirectory) {
+	    sector = -1;		// too long to be in any directory,
+	    break;			// or "/file/name"
+	}
+	strncpy(component, p, end - p);
+	component[end - p] = '\0';
+	p = end;
+
+	int parent = sector;
+	if (!kernel->dentryCache->Lookup(parent, component, &sector,
+							&isDirectory)) {
+	    int generation = kernel->dentryCache->Generation();
+	    Directory *directory = this;
+	    if (parent != DirectorySector) {	// read the directory in
+		OpenFile *file = new OpenFile(parent);
+		if (subDirectory == NULL)
+		    subDirectory = new Directory();
+		subDirectory->FetchFrom(file);
+		delete subFile;
+		subFile = file;
+		directory = subDirectory;
+	    }
+	    if (!directory->Lookup(component, &sector, &isDirectory)) {
+		sector = -1;
+		isDirectory = FALSE;
+	    }
+	    kernel->dentryCache->EnterLookup(parent, component, sector,
+						isDirectory, generation);
 	}
+	if (sector == -1)
+	    break;
+    }
+    delete subDirectory;
+    delete subFile;
+    return sector;
 }
@@ -18,16 +18,25 @@
 #define DIRECTORY_H
 
 #include "openfile.h"
+#include "disk.h"
 
-#define FileNameMaxLen 		9	// for simplicity, we assume 
-					// file names are <= 9 characters long
+#define FileNameMaxLen 		255	// file names are <= 255 characters
+					// long (here, with the leading '/')
+#define PathNameMaxLen 		1023	// and full path names <= 1023
+
+#define DirectoryVersion	0x44520001	// "DR", format 1: hashed
+#define DirBlockSize 		(4 * SectorSize)	// bytes per directory
+					// block; the unit a lookup reads
+#define DirLoadFactor 		8	// average entries per bucket before
+					// the number of buckets is doubled
 
 // The following class defines a "directory entry", representing a file
 // in the directory.  Each entry gives the name of the file, and where
 // the file's header is to be found on disk.
 //
-// Internal data structures kept public so that Directory operations can
-// access them directly.
+// This is the in-memory form of an entry; on disk, entries are packed
+// into directory blocks, with only as much room for the name as it
+// needs (see directory.cc).
 
 class DirectoryEntry {
   public:
@@ -43,21 +52,30 @@ class DirectoryEntry {
 // the directory describes a file, and where to find it on disk.
 //
 // The directory data structure can be stored in memory, or on disk.
-// When it is on disk, it is stored as a regular Nachos file.
+// When it is on disk, it is stored as a regular Nachos file, made of
+// DirBlockSize blocks.  Block 0 holds a header; the next blocks are
+// hash buckets, and a name is only ever looked for in the bucket it
+// hashes to (and in the overflow blocks chained to that bucket, if
+// it filled up).  When the directory holds more than DirLoadFactor
+// entries per bucket, or has more overflow blocks than buckets, the
+// number of buckets doubles.
 //
-// The constructor initializes a directory structure in memory; the
-// FetchFrom/WriteBack operations shuffle the directory information
-// from/to disk. 
+// The constructor initializes an empty directory in memory; FetchFrom
+// attaches the directory to its file on disk, after which blocks are
+// read in as they are needed, and WriteBack writes out the blocks that
+// were changed.
 
 class Directory {
   public:
-    Directory(int size); 		// Initialize an empty directory
-					// with space for "size" files
+    Directory(); 			// Initialize an empty directory
     ~Directory();			// De-allocate the directory
 
     void FetchFrom(OpenFile *file);  	// Init directory contents from disk
     void WriteBack(OpenFile *file);	// Write modifications to 
 					// directory contents back to disk
+    int FileSize();			// Number of bytes the directory
+					// needs on disk; the file must be
+					// extended to this before WriteBack
 
     int Find(char *name);		// Find the sector number of the 
 					// FileHeader for file: "name"
@@ -66,29 +84,47 @@ class Directory {
 
     bool Remove(char *name);		// Remove a file from the directory
 
+    bool NextEntry(int *position, DirectoryEntry *entry);
+					// Copy out the entry after
+					// "*position" (start from 0), and
+					// advance it; FALSE at the end
     void List();			// Print the names of all the files
 					//  in the directory
     void Print();			// Verbose print of the contents
 					//  of the directory -- all the file
 					//  names and their contents.
-    int FindPath(char *name);
-    DirectoryEntry* getTable(){return table;}
+    int FindPath(char *name);		// Find the sector number of the
+					// FileHeader for path "name", given
+					// that this is the root directory
 
   private:
-  
+
 	/*
 		MP4 Hint:
 		Directory is actually a "file", be careful of how it works with OpenFile and FileHdr.
-		Disk part: table
-		In-core part: tableSize
+		Disk part: the blocks
+		In-core part: the rest
 	*/
-  
-    int tableSize;			// Number of directory entries
-    DirectoryEntry *table;		// Table of pairs: 
-					// <file name, file header location> 
 
-    int FindIndex(char *name);		// Find the index into the directory 
-					//  table corresponding to "name"
+    OpenFile *file;			// Where blocks not yet in memory
+					// are read from
+    int maxBlocks;			// Size of the arrays below
+    char **blocks;			// Blocks read in (or created), by
+					// block number; NULL if not in memory
+    bool *dirty;			// Which blocks need writing back
+
+    char *GetBlock(int block);		// Return a block, reading it in
+    char *NewBlock(int block);		// Return an empty in-core block
+    void MakeRoom(int block);		// Grow the arrays to hold "block"
+    void Discard();			// Forget all the in-core blocks
+    int Bucket(char *name);		// Bucket block for "name"
+    bool FindEntry(char *name, int *block, int *offset);
+					// Locate the entry for "name"
+    bool Lookup(char *name, int *sector, bool *isDirectory);
+					// Find "name", and what it is
+    void Insert(char *name, int newSector, bool isDirectory);
+					// Store an entry, known to be new
+    void Grow();			// Double the number of buckets
 };
 
 #endif // DIRECTORY_H
@@ -3,12 +3,24 @@
 //	would be called the i-node).
 //
 //	The file header is used to locate where on disk the 
-//	file's data is stored.  We implement this as a fixed size
-//	table of pointers -- each entry in the table points to the 
-//	disk sector containing that portion of the file data
-//	(in other words, there are no indirect or doubly indirect 
-//	blocks). The table size is chosen so that the file header
-//	will be just big enough to fit in one disk sector, 
+//	file's data is stored.  We implement this as a short list of
+//	extents -- runs of consecutive disk sectors holding the start of
+//	the file -- followed by pointers to single, double and triple
+//	indirect index sectors, each of which is a table of
+//	PointersPerSector more sector numbers.  The table sizes are
+//	chosen so that the file header will be just big enough to fit
+//	in one disk sector, 
+//
+//	Data sectors are allocated when they are first written (Fill), so
+//	files can grow and have holes.  As long as a file has no sectors
+//	past its extents, a run written right after its last sector is
+//	added to the extents; once a file has a hole, everything after the
+//	hole goes in the index sectors.
+//
+//	A new file of at most InlineSize bytes is kept in its header
+//	instead, in the space of the extents and index pointers.  It is
+//	moved out to a data sector (MoveOut) when it is first allocated
+//	sectors, which is when it is written past InlineSize.
 //
 //      Unlike in a real system, we do not keep track of file permissions, 
 //	ownership, last modification date, etc., in the file header. 
@@ -26,9 +38,66 @@
 
 #include "filehdr.h"
 #include "debug.h"
-#include "synchdisk.h"
+#include "sectorcache.h"
+#include "journal.h"
 #include "main.h"
 
+//----------------------------------------------------------------------
+// Span
+// 	Return the number of data sectors reachable through a pointer
+//	with "depth" levels of index sectors below it.
+//----------------------------------------------------------------------
+
+static int
+Span(int depth)
+{
+    int span = 1;
+
+    while (depth-- > 0)
+	span *= PointersPerSector;
+    return span;
+}
+
+//----------------------------------------------------------------------
+// MostIndexSectors
+// 	Return the most index sectors that can be needed to find "count"
+//	new data sectors in a row past the extents, wherever they are in
+//	the file: at each level, one per span they cover, one more for
+//	the spans they only partly cover at either end, and one more in
+//	case they go from the double to the triple indirect pointers,
+//	whose spans do not line up with each other.
+//----------------------------------------------------------------------
+
+static int
+MostIndexSectors(int count)
+{
+    int total = 0;
+
+    for (int depth = 1; depth <= 3; depth++)
+	total += divRoundUp(count, Span(depth)) + 2;
+    return total;
+}
+
+//----------------------------------------------------------------------
+// NewIndex
+// 	Allocate an empty index sector, as close after "hint" as
+//	possible, and return its sector number, or -1 if the disk is full.
+//----------------------------------------------------------------------
+
+static int
+NewIndex(PersistentBitmap *freeMap, int hint)
+{
+    int index[PointersPerSector];
+    int length;
+    int sector = freeMap->FindAndSetRun(1, hint, &length);
+
+    if (sector == -1)
+	return -1;
+    memset(index, -1, sizeof(index));
+    kernel->journal->WriteSector(sector, (char *)index);
+    return sector;
+}
+
 //----------------------------------------------------------------------
 // MP4 mod tag
 // FileHeader::FileHeader
@@ -38,10 +107,11 @@
 //----------------------------------------------------------------------
 FileHeader::FileHeader()
 {
+	ASSERT(sizeof(FileHeader) == SectorSize);
+	version = FileHeaderVersion;
 	numBytes = -1;
 	numSectors = -1;
-	nextSector = -1; 
-	memset(dataSectors, -1, sizeof(dataSectors));
+	Clear();
 }
 
 //----------------------------------------------------------------------
@@ -53,50 +123,287 @@ FileHeader::FileHeader()
 //----------------------------------------------------------------------
 FileHeader::~FileHeader()
 {
-	delete nextHeader;
 	// nothing to do now
 }
 
 //----------------------------------------------------------------------
 // FileHeader::Allocate
 // 	Initialize a fresh file header for a newly created file.
-//	Allocate data blocks for the file out of the map of free disk blocks.
+//	Allocate data blocks for the file out of the map of free disk blocks,
+//	in as few runs of consecutive sectors as we can, along with the
+//	index blocks needed to find them if the runs do not all fit in
+//	the header.
 //	Return FALSE if there are not enough free blocks to accomodate
 //	the new file.
 //
 //	"freeMap" is the bit map of free disk sectors
 //	"fileSize" is the bit map of free disk sectors
+//	"near" is the sector the header itself is in
 //----------------------------------------------------------------------
 
 bool
-FileHeader::Allocate(PersistentBitmap *freeMap, int fileSize)
+FileHeader::Allocate(PersistentBitmap *freeMap, int fileSize, int near)
 { 
-    numBytes = (fileSize < MaxFileSize) ? fileSize : MaxFileSize;
-    numSectors  = divRoundUp(numBytes, SectorSize);
-    if (freeMap->NumClear() < divRoundUp(fileSize, SectorSize))
+    numBytes = 0;
+    numSectors = 0;
+    return Extend(freeMap, fileSize, near);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::AllocateSparse
+// 	Initialize a fresh file header for a newly created file, "fileSize"
+//	bytes long, but without allocating any data blocks: the whole file
+//	is a hole, and sectors are allocated as they are written.  If the
+//	file is small enough, it is kept in the header for now.  Return
+//	FALSE if the file would be too big.
+//
+//	"fileSize" is the length of the new file
+//----------------------------------------------------------------------
+
+bool
+FileHeader::AllocateSparse(int fileSize)
+{
+    if (fileSize < 0 || fileSize > (int)MaxFileSize)
+	return FALSE;
+    numBytes = fileSize;
+    numSectors = 0;
+    if (fileSize <= InlineSize) {
+	numExtents = InlineData;
+	memset(data, 0, InlineSize);
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Extend
+// 	Make a file "fileSize" bytes long, allocating data blocks for the
+//	new sectors just as Allocate does, continuing from the last sector
+//	of the file when the sectors after it are free.  Return FALSE,
+//	leaving the header untouched, if there are not enough free blocks.
+//
+//	The first data block of a file goes in the first free run after
+//	its header that is big enough, so both are in the same allocation
+//	group (see pbitmap.h) when there is room.
+//
+//	"freeMap" is the bit map of free disk sectors
+//	"fileSize" is the new length of the file, at least the old one
+//	"near" is the sector the header itself is in
+//----------------------------------------------------------------------
+
+bool
+FileHeader::Extend(PersistentBitmap *freeMap, int fileSize, int near)
+{
+    int newSectors = divRoundUp(fileSize, SectorSize);
+
+    ASSERT(fileSize >= numBytes);
+    if (newSectors > (int)MaxFileSectors)
+	return FALSE;		// too big for the header
+    if (IsInline() && !MoveOut(freeMap, near))
+	return FALSE;		// not enough space
+    if (freeMap->NumClear() < newSectors - numSectors
+		+ MostIndexSectors(newSectors - numSectors))
 	return FALSE;		// not enough space
-	fileSize -= numBytes;
-    for (int i = 0; i < numSectors; i++) {
-	dataSectors[i] = freeMap->FindAndSet();
+
+    int hint = near;		// next fit after the header, at first
+    if (numSectors > 0)
+	hint = ByteToSector((numSectors - 1) * SectorSize) + 1;
+    for (int n = numSectors; n < newSectors; ) {
+	int length;
+	int start = freeMap->FindAndSetRun(newSectors - n, hint, &length);
 	// since we checked that there was enough free space,
 	// we expect this to succeed
-	ASSERT(dataSectors[i] >= 0);
+	ASSERT(start >= 0);
+	bool added = AddRun(n, start, length, freeMap);
+	ASSERT(added);
+	n += length;
+	hint = start + length;	// keep going from the end of the run
     }
+    numSectors = newSectors;
+    numBytes = fileSize;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Fill
+// 	Get a range of the file ready to be written: allocate data blocks
+//	for the sectors of the range that are holes, and make the file at
+//	least long enough to hold the range.  Each run of holes is given a
+//	run of consecutive sectors if possible, right after the data sector
+//	before it, so a file written from start to end is laid out in
+//	order.  An inline file is moved out of its header first.  Return
+//	FALSE if there are not enough free blocks, or the file would be
+//	too big; the header is left untouched, but for having been moved
+//	out.
+//
+//	"freeMap" is the bit map of free disk sectors
+//	"position" is where the range starts in the file
+//	"size" is the length of the range
+//	"near" is the sector the header itself is in
+//----------------------------------------------------------------------
+
+bool
+FileHeader::Fill(PersistentBitmap *freeMap, int position, int size,
+								int near)
+{
+    int first = position / SectorSize;
+    int last = (position + size - 1) / SectorSize;
+    int holes = 0;
+    int hint = near, sector;
+
+    ASSERT(position >= 0 && size > 0);
+    if (position + size > (int)MaxFileSize)
+	return FALSE;		// too big for the header
+    if (IsInline() && !MoveOut(freeMap, near))
+	return FALSE;		// not enough space
+    for (int n = first; n <= last; n++)
+	if (n >= numSectors) {
+	    holes += last - n + 1;
+	    break;
+	} else if (ByteToSector(n * SectorSize) == -1)
+	    holes++;
+    // holes that are not in a row may each need an index sector at
+    // every level, but no more than the whole range could
+    if (freeMap->NumClear() < holes
+		+ min(3 * holes, MostIndexSectors(last - first + 1)))
+	return FALSE;		// not enough space
 
+    if (first > 0 && (sector = ByteToSector((first - 1) * SectorSize)) != -1)
+	hint = sector + 1;	// carry on after the sector before
+    for (int n = first; n <= last; ) {
+	int count, length;
 
-	if(fileSize > 0){
-	//	cout<<"Now Remain fileSize is =>"<<fileSize;
-		nextSector = freeMap->FindAndSet();
-		if(nextSector == -1)return FALSE;
-		nextHeader = new FileHeader;
-		if(!nextHeader->Allocate(freeMap, fileSize)) return FALSE; // recursively allocate
+	if (n < numSectors && (sector = ByteToSector(n * SectorSize)) != -1) {
+	    hint = sector + 1;
+	    n++;
+	    continue;
 	}
+	for (count = 1; n + count <= last; count++)
+	    if (n + count < numSectors
+			&& ByteToSector((n + count) * SectorSize) != -1)
+		break;
+	int start = freeMap->FindAndSetRun(count, hint, &length);
+	// since we checked that there was enough free space,
+	// we expect this to succeed
+	ASSERT(start >= 0);
+	bool added = AddRun(n, start, length, freeMap);
+	ASSERT(added);
+	numSectors = max(numSectors, n + length);
+	n += length;
+	hint = start + length;	// keep going from the end of the run
+    }
+    numBytes = max(numBytes, position + size);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::IsAllocated
+// 	Return TRUE if a range of the file lies within the file's length,
+//	and has a data sector for every sector, so that writing it needs
+//	no help from Fill.
+//
+//	"position" is where the range starts in the file
+//	"size" is the length of the range
+//----------------------------------------------------------------------
+
+bool
+FileHeader::IsAllocated(int position, int size)
+{
+    int first = position / SectorSize;
+    int last = (position + size - 1) / SectorSize;
+
+    if (position + size > numBytes || last >= numSectors)
+	return FALSE;
+    for (int n = max(first, ExtentSectors()); n <= last; n++)
+	if (ByteToSector(n * SectorSize) == -1)
+	    return FALSE;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::IsInline
+// 	Return TRUE if the file's contents are kept in its header.
+//----------------------------------------------------------------------
+
+bool
+FileHeader::IsInline()
+{
+    return numExtents == InlineData;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::ReadInline
+// 	Copy a range of a file kept in its header out of the header.
+//
+//	"into" is the buffer to copy the data to
+//	"position" is where the range starts in the file
+//	"size" is the length of the range, which ends within InlineSize
+//----------------------------------------------------------------------
+
+void
+FileHeader::ReadInline(char *into, int position, int size)
+{
+    ASSERT(IsInline() && position >= 0 && position + size <= InlineSize);
+    bcopy(&data[position], into, size);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::WriteInline
+// 	Copy a range of a file kept in its header into the header, making
+//	the file long enough to hold it.  The caller writes the header
+//	back.
+//
+//	"from" is the data to be written
+//	"position" is where the range starts in the file
+//	"size" is the length of the range, which ends within InlineSize
+//----------------------------------------------------------------------
+
+void
+FileHeader::WriteInline(char *from, int position, int size)
+{
+    ASSERT(IsInline() && position >= 0 && position + size <= InlineSize);
+    bcopy(from, &data[position], size);
+    numBytes = max(numBytes, position + size);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::MoveOut
+// 	Move the contents of a file kept in its header to a data sector
+//	of its own, as close after "near" as possible, and make the header
+//	an ordinary one.  An empty file needs no data sector.  Return
+//	FALSE, leaving the header untouched, if the disk is full.
+//
+//	"freeMap" is the bit map of free disk sectors
+//	"near" is the sector the header itself is in
+//----------------------------------------------------------------------
+
+bool
+FileHeader::MoveOut(PersistentBitmap *freeMap, int near)
+{
+    char buffer[SectorSize];
+    int sector = -1, length;
+
+    ASSERT(IsInline());
+    if (numBytes > 0) {
+	if ((sector = freeMap->FindAndSetRun(1, near, &length)) == -1)
+	    return FALSE;
+	memset(buffer, 0, SectorSize);
+	bcopy(data, buffer, numBytes);
+	kernel->journal->WriteSector(sector, buffer);
+    }
+    DEBUG(dbgFile, "Moving " << numBytes << " bytes out of the header to "
+								<< sector);
+    Clear();
+    if (sector != -1) {
+	AddRun(0, sector, 1, freeMap);
+	numSectors = 1;
+    }
     return TRUE;
 }
 
 //----------------------------------------------------------------------
 // FileHeader::Deallocate
-// 	De-allocate all the space allocated for data blocks for this file.
+// 	De-allocate all the space allocated for data blocks for this file,
+//	and the index blocks pointing to them.
 //
 //	"freeMap" is the bit map of free disk sectors
 //----------------------------------------------------------------------
@@ -104,11 +411,53 @@ FileHeader::Allocate(PersistentBitmap *freeMap, int fileSize)
 void 
 FileHeader::Deallocate(PersistentBitmap *freeMap)
 {
-    for (int i = 0; i < numSectors; i++) {
-	ASSERT(freeMap->Test((int) dataSectors[i]));  // ought to be marked!
-	freeMap->Clear((int) dataSectors[i]);
+    if (IsInline())
+	return;				// nothing but the header
+    for (int i = 0; i < numExtents; i++)
+	for (int j = 0; j < extents[i].length; j++) {
+	    int sector = extents[i].start + j;
+	    ASSERT(freeMap->Test(sector));  // ought to be marked!
+	    freeMap->Clear(sector);
+	}
+    for (int i = 0; i < NumSingle; i++)
+	if (singleIndirect[i] != -1)
+	    FreeIndex(singleIndirect[i], 1, freeMap);
+    for (int i = 0; i < NumDouble; i++)
+	if (doubleIndirect[i] != -1)
+	    FreeIndex(doubleIndirect[i], 2, freeMap);
+    for (int i = 0; i < NumTriple; i++)
+	if (tripleIndirect[i] != -1)
+	    FreeIndex(tripleIndirect[i], 3, freeMap);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::FreeIndex
+// 	De-allocate an index sector, along with every index and data
+//	sector it leads to.
+//
+//	"sector" is the index sector
+//	"depth" is the number of index levels from it down to the data
+//	"freeMap" is the bit map of free disk sectors
+//----------------------------------------------------------------------
+
+void
+FileHeader::FreeIndex(int sector, int depth, PersistentBitmap *freeMap)
+{
+    int index[PointersPerSector];
+
+    kernel->sectorCache->ReadSector(sector, (char *)index);
+    for (int i = 0; i < (int)PointersPerSector; i++) {
+	if (index[i] == -1)
+	    continue;
+	if (depth > 1)
+	    FreeIndex(index[i], depth - 1, freeMap);
+	else {
+	    ASSERT(freeMap->Test(index[i]));	// ought to be marked!
+	    freeMap->Clear(index[i]);
+	}
     }
-	if(nextSector != -1) nextHeader->Deallocate(freeMap);
+    ASSERT(freeMap->Test(sector));
+    freeMap->Clear(sector);
 }
 
 //----------------------------------------------------------------------
@@ -121,22 +470,19 @@ FileHeader::Deallocate(PersistentBitmap *freeMap)
 void
 FileHeader::FetchFrom(int sector)
 {
-    kernel->synchDisk->ReadSector(sector, (char *)this);
+    kernel->sectorCache->ReadSector(sector, (char *)this);
 	
 	/*
 		MP4 Hint:
 		After you add some in-core informations, you will need to rebuild the header's structure
 	*/
-	if(nextSector != -1){
-		nextHeader = new FileHeader;
-		nextHeader->FetchFrom(nextSector);
-	}
-	
 }
 
 //----------------------------------------------------------------------
 // FileHeader::WriteBack
 // 	Write the modified contents of the file header back to disk. 
+//	Index sectors are written as they are changed, so only the
+//	header itself is left.
 //
 //	"sector" is the disk sector to contain the file header
 //----------------------------------------------------------------------
@@ -144,7 +490,7 @@ FileHeader::FetchFrom(int sector)
 void
 FileHeader::WriteBack(int sector)
 {
-    kernel->synchDisk->WriteSector(sector, (char *)this); 
+    kernel->journal->WriteSector(sector, (char *)this); 
 	
 	/*
 		MP4 Hint:
@@ -154,9 +500,160 @@ FileHeader::WriteBack(int sector)
 		memcpy(buf + offset, &dataToBeWritten, sizeof(dataToBeWritten));
 		...
 	*/
-	
-	if(nextSector != -1) nextHeader->WriteBack(nextSector);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Clear
+// 	Make the header describe no data sectors and no index sectors.
+//----------------------------------------------------------------------
+
+void
+FileHeader::Clear()
+{
+    numExtents = 0;
+    memset(extents, -1, sizeof(extents));
+    memset(singleIndirect, -1, sizeof(singleIndirect));
+    memset(doubleIndirect, -1, sizeof(doubleIndirect));
+    memset(tripleIndirect, -1, sizeof(tripleIndirect));
+}
+
+//----------------------------------------------------------------------
+// FileHeader::ExtentSectors
+// 	Return the number of data sectors described by the extents;
+//	the sectors after those are found through the index sectors.
+//----------------------------------------------------------------------
+
+int
+FileHeader::ExtentSectors()
+{
+    int count = 0;
+
+    for (int i = 0; i < numExtents; i++)
+	count += extents[i].length;
+    return count;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::AddRun
+// 	Record that data sectors "n" to "n + length - 1" of the file are
+//	stored in consecutive disk sectors from "start" on.  As long as
+//	the file has no sectors past its extents, and the run starts right
+//	after them, this extends the last extent or adds a new one;
+//	otherwise the sectors go in the index sectors.  Return FALSE if
+//	there is no room for index sectors.
+//
+//	"n" is the number of the first data sector within the file; the
+//	sectors of the run must be holes
+//	"start" is the disk sector holding it
+//	"length" is the number of sectors in the run
+//	"freeMap" is the bit map of free disk sectors
+//----------------------------------------------------------------------
+
+bool
+FileHeader::AddRun(int n, int start, int length, PersistentBitmap *freeMap)
+{
+    int extentSectors = ExtentSectors();
+
+    if (n == extentSectors && numSectors == extentSectors) {
+	if (numExtents > 0 && extents[numExtents - 1].start
+			+ extents[numExtents - 1].length == start) {
+	    extents[numExtents - 1].length += length;
+	    return TRUE;
+	}
+	if (numExtents < NumExtents) {
+	    extents[numExtents].start = start;
+	    extents[numExtents].length = length;
+	    numExtents++;
+	    return TRUE;
+	}
+    }
+    for (int i = 0; i < length; i++)
+	if (!MapSector(n - extentSectors + i, start + i, freeMap))
+	    return FALSE;
+    return TRUE;
+}
 
+//----------------------------------------------------------------------
+// FileHeader::FindPointer
+// 	Return the index pointer of the header that leads to sector "*n"
+//	past the extents.  On return, "*depth" is the number of index
+//	sectors between the pointer and the data, and "*n" is the number
+//	of the data sector among those reachable through the pointer.
+//----------------------------------------------------------------------
+
+int *
+FileHeader::FindPointer(int *n, int *depth)
+{
+    int span;
+
+    span = Span(1);
+    if (*n < NumSingle * span) {
+	*depth = 1;
+	int *entry = &singleIndirect[*n / span];
+	*n %= span;
+	return entry;
+    }
+    *n -= NumSingle * span;
+
+    span = Span(2);
+    if (*n < NumDouble * span) {
+	*depth = 2;
+	int *entry = &doubleIndirect[*n / span];
+	*n %= span;
+	return entry;
+    }
+    *n -= NumDouble * span;
+
+    span = Span(3);
+    ASSERT(*n < NumTriple * span);
+    *depth = 3;
+    int *entry = &tripleIndirect[*n / span];
+    *n %= span;
+    return entry;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::MapSector
+// 	Record "sector" as holding data sector "n" past the extents,
+//	allocating any index sectors on the way that do not exist yet,
+//	right after the data.  Return FALSE if the disk has no room for
+//	them.
+//
+//	"n" is the number of the data sector, counting from the end of
+//	the extents
+//	"sector" is the disk sector holding it
+//	"freeMap" is the bit map of free disk sectors
+//----------------------------------------------------------------------
+
+bool
+FileHeader::MapSector(int n, int sector, PersistentBitmap *freeMap)
+{
+    int index[PointersPerSector];
+    int depth, indexSector;
+    int *entry = FindPointer(&n, &depth);
+
+    if (*entry == -1 && (*entry = NewIndex(freeMap, sector + 1)) == -1)
+	return FALSE;
+
+    indexSector = *entry;
+    for (;;) {
+	int span = Span(--depth);
+	int slot = n / span;
+
+	n %= span;
+	kernel->sectorCache->ReadSector(indexSector, (char *)index);
+	if (depth == 0) {
+	    index[slot] = sector;
+	    kernel->journal->WriteSector(indexSector, (char *)index);
+	    return TRUE;
+	}
+	if (index[slot] == -1) {
+	    if ((index[slot] = NewIndex(freeMap, sector + 1)) == -1)
+		return FALSE;
+	    kernel->journal->WriteSector(indexSector, (char *)index);
+	}
+	indexSector = index[slot];
+    }
 }
 
 //----------------------------------------------------------------------
@@ -164,7 +661,9 @@ FileHeader::WriteBack(int sector)
 // 	Return which disk sector is storing a particular byte within the file.
 //      This is essentially a translation from a virtual address (the
 //	offset in the file) to a physical address (the sector where the
-//	data at the offset is stored).
+//	data at the offset is stored).  Past the extents, at most three
+//	index sectors are read on the way.  Return -1 if the byte is in
+//	a hole.
 //
 //	"offset" is the location within the file of the byte in question
 //----------------------------------------------------------------------
@@ -172,10 +671,29 @@ FileHeader::WriteBack(int sector)
 int
 FileHeader::ByteToSector(int offset)
 {
-	if(offset/SectorSize < NumDirect)
-	    return(dataSectors[offset / SectorSize]);
-	else
-		return nextHeader->ByteToSector(offset - MaxFileSize);
+    int index[PointersPerSector];
+    int n = offset / SectorSize;
+    int depth, sector;
+
+    if (n >= numSectors)
+	return -1;			// past the last data sector
+
+    for (int i = 0; i < numExtents; i++) {
+	if (n < extents[i].length)
+	    return extents[i].start + n;
+	n -= extents[i].length;
+    }
+
+    sector = *FindPointer(&n, &depth);
+
+    while (depth > 0 && sector != -1) {
+	int span = Span(--depth);
+
+	kernel->sectorCache->ReadSector(sector, (char *)index);
+	sector = index[n / span];
+	n %= span;
+    }
+    return sector;
 }
 
 //----------------------------------------------------------------------
@@ -202,11 +720,27 @@ FileHeader::Print()
     char *data = new char[SectorSize];
 
     printf("FileHeader contents.  File size: %d.  File blocks:\n", numBytes);
+    if (IsInline()) {
+	printf("(in the header)\nFile contents:\n");
+	for (j = 0; j < numBytes; j++)	// the header's data, not ours
+	    if ('\040' <= this->data[j] && this->data[j] <= '\176')
+		printf("%c", this->data[j]);
+	    else
+		printf("\\%x", (unsigned char)this->data[j]);
+	printf("\n");
+	delete [] data;
+	return;
+    }
     for (i = 0; i < numSectors; i++)
-	printf("%d ", dataSectors[i]);
+	printf("%d ", ByteToSector(i * SectorSize));
     printf("\nFile contents:\n");
     for (i = k = 0; i < numSectors; i++) {
-	kernel->synchDisk->ReadSector(dataSectors[i], data);
+	int sector = ByteToSector(i * SectorSize);
+
+	if (sector == -1)
+	    memset(data, 0, SectorSize);	// a hole
+	else
+	    kernel->sectorCache->ReadSector(sector, data);
         for (j = 0; (j < SectorSize) && (k < numBytes); j++, k++) {
 	    if ('\040' <= data[j] && data[j] <= '\176')   // isprint(data[j])
 		printf("%c", data[j]);
@@ -17,19 +17,66 @@
 #include "disk.h"
 #include "pbitmap.h"
 
-#define NumDirect 	((SectorSize - 4 * sizeof(int)) / sizeof(int))
-#define MaxFileSize 	(NumDirect * SectorSize)
+// The on-disk file header finds the data sectors of a file in two
+// ways.  The start of the file is described by up to NumExtents
+// extents -- runs of consecutive sectors -- which is all that most
+// files need, since the allocator hands out contiguous runs.  Sectors
+// past the extents are found through single, double and triple
+// indirect index sectors, each holding PointersPerSector further
+// sector numbers, like a UNIX i-node.  With 128-byte sectors, double
+// indirection only reaches 128KB, so a few triple indirect pointers
+// are needed to hold the larger test files.
+//
+// Files may be sparse: a data sector is only allocated when it is
+// first written, and a sector that was never written is a "hole",
+// which reads as zeroes.  A hole is -1 in an index sector, or is past
+// the file's last data sector; extents never hold holes.
+//
+// A file small enough has no data sectors at all: its contents are kept
+// in the header sector, where the extents and index pointers would be,
+// so reading it takes no disk read besides the header's.  A file moves
+// out to data sectors the first time it is written past InlineSize.
+
+#define FileHeaderVersion	0x46480008	// "FH", format 8: extents,
+						// hashed directories, journal,
+						// sparse files, inline data
+#define PointersPerSector	(SectorSize / sizeof(int))
+#define NumExtents		11	// extents in the header
+#define NumSingle		2	// single indirect pointers
+#define NumDouble		1	// double indirect pointers
+#define NumTriple		3	// triple indirect pointers
+#define MaxFileSectors	(NumExtents + NumSingle * PointersPerSector \
+			  + NumDouble * PointersPerSector * PointersPerSector \
+			  + NumTriple * PointersPerSector * PointersPerSector \
+						* PointersPerSector)
+					// however fragmented the file is
+#define MaxFileSize 	(MaxFileSectors * SectorSize)
+#define InlineSize	((int) (SectorSize - 4 * sizeof(int)))
+					// most bytes kept in the header
+#define InlineData	-1		// numExtents of a file kept in
+					// its header
+
+// The following class defines an extent: "length" data sectors of a
+// file, stored on disk in consecutive sectors starting at "start".
+
+class Extent {
+  public:
+    int start;				// First disk sector of the run
+    int length;				// Number of sectors in the run
+};
 
 // The following class defines the Nachos "file header" (in UNIX terms,  
 // the "i-node"), describing where on disk to find all of the data in the file.
-// The file header is organized as a simple table of pointers to
-// data blocks. 
+// The file header is organized as a list of extents, followed by
+// pointers to index blocks for files that do not fit in the extents.
+// An unused pointer holds -1.
 //
 // The file header data structure can be stored in memory or on disk.
 // When it is on disk, it is stored in a single sector -- this means
 // that we assume the size of this data structure to be the same
-// as one disk sector.  Without indirect addressing, this
-// limits the maximum file length to just under 4K bytes.
+// as one disk sector.  Index blocks are read through the sector cache
+// when needed, so finding the sector for any offset takes a scan of
+// the extents and at most three index reads, however large the file.
 //
 // There is no constructor; rather the file header can be initialized
 // by allocating blocks for the file (if it is a new file), or by
@@ -41,11 +88,30 @@ class FileHeader {
 	FileHeader(); // dummy constructor to keep valgrind happy
 	~FileHeader();
 	
-    bool Allocate(PersistentBitmap *bitMap, int fileSize);// Initialize a file header, 
+    bool Allocate(PersistentBitmap *bitMap, int fileSize, int near);
+						// Initialize a file header, 
 						//  including allocating space 
 						//  on disk for the file data
+    bool AllocateSparse(int fileSize);	// Initialize a file header for a
+					//  new file that is all hole
+    bool Extend(PersistentBitmap *bitMap, int fileSize, int near);
+					// Grow the file to "fileSize" bytes,
+					//  allocating the new data blocks
+    bool Fill(PersistentBitmap *bitMap, int position, int size, int near);
+					// Allocate data blocks for the holes
+					//  in a range of the file, growing
+					//  the file to cover it
+    bool IsAllocated(int position, int size);
+					// Does a range of the file, within
+					//  its length, have no holes?
+    bool IsInline();			// Are the file's contents kept in
+					//  the header?
+    void ReadInline(char *into, int position, int size);
+    void WriteInline(char *from, int position, int size);
+					// Read/write a range of a file kept
+					//  in the header, within InlineSize
     void Deallocate(PersistentBitmap *bitMap);  // De-allocate this file's 
-						//  data blocks
+						//  data and index blocks
 
     void FetchFrom(int sectorNumber); 	// Initialize file header from disk
     void WriteBack(int sectorNumber); 	// Write modifications to file header
@@ -53,7 +119,7 @@ class FileHeader {
 
     int ByteToSector(int offset);	// Convert a byte offset into the file
 					// to the disk sector containing
-					// the byte
+					// the byte (-1 for a hole)
 
     int FileLength();			// Return the length of the file 
 					// in bytes
@@ -62,8 +128,6 @@ class FileHeader {
 
 	int getNumBytes(){return numBytes;}
 	int getNumSectors(){return numSectors;}
-	int getNextSector(){return nextSector;}
-	FileHeader* getNextHeader(){return nextHeader;}
 
   private:
 	
@@ -76,18 +140,56 @@ class FileHeader {
 		In order to implement a data structure, you will need to add some "in-core" data
 		to maintain data structure.
 		
-		Disk Part - numBytes, numSectors, dataSectors occupy exactly 128 bytes and will be
-		written to a sector on disk.
+		Disk Part - version, numBytes, numSectors, the extents and
+		the index pointers (or the data of an inline file) occupy exactly 128 bytes and will be written to a sector on disk.
 		In-core part - none
 		
 	*/
 	
+    int version;			// FileHeaderVersion
     int numBytes;			// Number of bytes in the file
-    int numSectors;			// Number of data sectors in the file
-    int dataSectors[NumDirect];		// Disk sector numbers for each data 
-					// block in the file
-	int nextSector; // linked
-	FileHeader *nextHeader;
+    int numSectors;			// Number of sectors of the file up to
+					// and including its last data sector
+    int numExtents;			// Number of extents in use, or
+					// InlineData
+    union {
+	struct {
+	    Extent extents[NumExtents];	// The first sectors of the file,
+					// as runs of consecutive sectors
+	    int singleIndirect[NumSingle];
+					// Index sectors of data sectors
+	    int doubleIndirect[NumDouble];
+					// Index sectors of single indirect
+					// index sectors
+	    int tripleIndirect[NumTriple];
+					// Index sectors of double indirect
+					// index sectors
+	};
+	char data[InlineSize];		// The contents of an inline file;
+					// zeroes past numBytes
+    };
+
+    void Clear();			// No data sectors, no index sectors
+    bool MoveOut(PersistentBitmap *freeMap, int near);
+					// Move an inline file's contents to
+					// a data sector
+    int ExtentSectors();		// Number of sectors in the extents
+    bool AddRun(int n, int start, int length, PersistentBitmap *freeMap);
+					// Record a run of sectors as data
+					// sectors "n" on; as an extent if
+					// possible
+    int *FindPointer(int *n, int *depth);
+					// Return the index pointer leading
+					// to sector "*n" past the extents,
+					// and how many index sectors lie
+					// below it
+    bool MapSector(int n, int sector, PersistentBitmap *freeMap);
+					// Record "sector" as sector "n"
+					// past the extents, allocating
+					// index sectors
+    void FreeIndex(int sector, int depth, PersistentBitmap *freeMap);
+					// De-allocate an index sector and
+					// everything below it
 };
 
 #endif // FILEHDR_H
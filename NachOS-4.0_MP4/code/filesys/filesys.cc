@@ -28,16 +28,37 @@
 //	modified part of the directory and/or bitmap, we simply discard
 //	the changed version, without writing it back to disk.
 //
+//	The changes an operation makes are written through the journal
+//	(journal.h), between Begin and End, so that after a crash either
+//	all of them or none of them are on disk.  The journal's log takes
+//	up the sectors right after the superblock, which follows the
+//	directory's header.
+//
+//	The bitmap is read in once, the first time an operation needs it,
+//	and kept in memory; only the sectors of it that an operation
+//	changed are written back.  Discarding changes to it means reading
+//	it again.  Only the part of it that was ever written is on disk
+//	(see Superblock), so formatting a disk writes a handful of sectors,
+//	and mounting one reads the superblock, the journal and the root
+//	directory's header.
+//
+//	Sectors are allocated by groups of tracks (pbitmap.h): a file's
+//	header goes near its directory's header, and its data near its
+//	header, while new directories go to the emptiest group.
+//
+//	Files are created sparse: the size given to Create is only their
+//	initial length, and data sectors are allocated as the file is
+//	written (Fill), growing it if need be.
+//
 // 	Our implementation at this point has the following restrictions:
 //
 //	   there is no synchronization for concurrent accesses
-//	   files have a fixed size, set when the file is created
-//	   files cannot be bigger than about 3KB in size
+//	   files cannot be bigger than MaxFileSize (about 12MB)
 //	   there is no hierarchical directory structure, and only a limited
 //	     number of files can be added to the system
-//	   there is no attempt to make the system robust to failures
-//	    (if Nachos exits in the middle of an operation that modifies
-//	    the file system, it may corrupt the disk)
+//	   only the file system's own data structures are made robust to
+//	    failures (if Nachos exits in the middle of writing a file,
+//	    part of the new contents may be lost)
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -51,6 +72,11 @@
 #include "directory.h"
 #include "filehdr.h"
 #include "filesys.h"
+#include "inodetable.h"
+#include "dentrycache.h"
+#include "journal.h"
+#include "sectorcache.h"
+#include "main.h"
 
 // Sectors containing the file headers for the bitmap of free sectors,
 // and the directory of files.  These file headers are placed in well-known 
@@ -69,11 +95,13 @@
 // FileSystem::FileSystem
 // 	Initialize the file system.  If format = TRUE, the disk has
 //	nothing on it, and we need to initialize the disk to contain
-//	an empty directory, and a bitmap of free sectors (with almost but
-//	not all of the sectors marked as free).  
+//	an empty directory, an empty journal, and a bitmap of free sectors
+//	(with almost but not all of the sectors marked as free).  
 //
-//	If format = FALSE, we just have to open the files
-//	representing the bitmap and the directory.
+//	If format = FALSE, we just have to replay the journal, in case
+//	Nachos stopped in the middle of an operation, check the superblock,
+//	and open the file representing the directory; the bitmap is left
+//	until it is needed.
 //
 //	"format" -- should we initialize the disk?
 //----------------------------------------------------------------------
@@ -82,8 +110,8 @@ FileSystem::FileSystem(bool format)
 { 
     DEBUG(dbgFile, "Initializing the file system.");
     if (format) {
-        PersistentBitmap *freeMap = new PersistentBitmap(NumSectors);
-        Directory *directory = new Directory(NumDirEntries);
+        freeMap = new PersistentBitmap(NumSectors);
+        Directory *directory = new Directory();
 		FileHeader *mapHdr = new FileHeader;
 		FileHeader *dirHdr = new FileHeader;
 
@@ -93,11 +121,19 @@ FileSystem::FileSystem(bool format)
 		// (make sure no one else grabs these!)
 		freeMap->Mark(FreeMapSector);	    
 		freeMap->Mark(DirectorySector);
+		freeMap->Mark(SuperblockSector);
+		for (int i = 0; i <= JournalLogSectors; i++)
+			freeMap->Mark(JournalSector + i);	// header and log
+		kernel->journal->Format();
+		superblock = new Superblock;
+		memset(superblock, 0, sizeof(Superblock));
+		superblock->magic = SuperblockMagic;
+		superblock->headerVersion = FileHeaderVersion;
 		// Second, allocate space for the data blocks containing the contents
 		// of the directory and bitmap files.  There better be enough space!
 
-		ASSERT(mapHdr->Allocate(freeMap, FreeMapFileSize));
-		ASSERT(dirHdr->Allocate(freeMap, DirectoryFileSize));
+		ASSERT(mapHdr->Allocate(freeMap, FreeMapFileSize, FreeMapSector));
+		ASSERT(dirHdr->Allocate(freeMap, DirectoryFileSize, DirectorySector));
 		// Flush the bitmap and directory FileHeaders back to disk
 		// We need to do this before we can "Open" the file, since open
 		// reads the file header off of disk (and currently the disk has garbage
@@ -119,21 +155,40 @@ FileSystem::FileSystem(bool format)
 		// to hold the file data for the directory and bitmap.
 
         DEBUG(dbgFile, "Writing bitmap and directory back to disk.");
-		freeMap->WriteBack(freeMapFile);	 // flush changes to disk
+		WriteBackFreeMap();	 // flush changes to disk, and the
+					 // superblock with them
 		directory->WriteBack(directoryFile);
+		freeMapFile->Flush();		// not in a journal operation,
+		directoryFile->Flush();		// so these were held back
 		if (debug->IsEnabled('f')) {
 			freeMap->Print();
 			directory->Print();
         }
-        delete freeMap; 
 		delete directory; 
 		delete mapHdr; 
 		delete dirHdr;
     } else {
-		// if we are not formatting the disk, just open the files representing
-		// the bitmap and directory; these are left open while Nachos is running
-        freeMapFile = new OpenFile(FreeMapSector);
+		kernel->journal->Recover();
+
+		// a disk formatted with another header layout would be
+		// misread, so refuse it rather than trash it; the superblock
+		// is read after the journal is replayed, since it may be
+		// in the log
+		superblock = new Superblock;
+		kernel->sectorCache->ReadSector(SuperblockSector,
+							(char *)superblock);
+		if (superblock->magic != SuperblockMagic
+			|| superblock->headerVersion != FileHeaderVersion) {
+			cerr << "Disk has an unknown file system format; "
+				<< "format it again with -f\n";
+			Abort();
+		}
+
+		// if we are not formatting the disk, just open the file representing
+		// the directory; it is left open while Nachos is running
         directoryFile = new OpenFile(DirectorySector);
+        freeMapFile = NULL;		// opened, and the bitmap
+        freeMap = NULL;			// read in, when first needed
     }
 }
 
@@ -143,20 +198,58 @@ FileSystem::FileSystem(bool format)
 //----------------------------------------------------------------------
 FileSystem::~FileSystem()
 {
+	delete freeMap;
 	delete freeMapFile;
 	delete directoryFile;
+	delete superblock;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::FreeMap
+// 	Return the in-core bitmap of free sectors, reading it from disk
+//	the first time.  Commands that only look up files never pay for
+//	reading it, nor for opening its file.
+//----------------------------------------------------------------------
+
+PersistentBitmap *
+FileSystem::FreeMap()
+{
+    if (freeMap == NULL) {
+	freeMapFile = new OpenFile(FreeMapSector);
+	freeMap = new PersistentBitmap(freeMapFile, NumSectors,
+						superblock->mapSectors);
+    }
+    return freeMap;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::WriteBackFreeMap
+// 	Write back the sectors of the bitmap of free sectors that changed.
+//	If that took sectors of its file that were never written before,
+//	the superblock is written too, in the same operation.
+//----------------------------------------------------------------------
+
+void
+FileSystem::WriteBackFreeMap()
+{
+    freeMap->WriteBack(freeMapFile);
+    if (freeMap->NumWritten() != superblock->mapSectors) {
+	superblock->mapSectors = freeMap->NumWritten();
+	kernel->journal->WriteSector(SuperblockSector, (char *)superblock);
+    }
 }
 
 //----------------------------------------------------------------------
 // FileSystem::Create
 // 	Create a file in the Nachos file system (similar to UNIX create).
-//	Since we can't increase the size of files dynamically, we have
-//	to give Create the initial size of the file.
+//	The file starts out "initialSize" bytes long, all of it a hole:
+//	its data blocks are only allocated when they are written.  A
+//	directory, though, gets all its blocks right away.
 //
 //	The steps to create a file are:
 //	  Make sure the file doesn't already exist
 //        Allocate a sector for the file header
-// 	  Allocate space on disk for the data blocks for the file
+// 	  Allocate space on disk for the data blocks for a directory
 //	  Add the name to the directory
 //	  Store the new file header on disk 
 //	  Flush the changes to the bitmap and the directory back to disk
@@ -167,7 +260,8 @@ FileSystem::~FileSystem()
 //   		file is already in directory
 //	 	no free space for file header
 //	 	no free entry for file in directory
-//	 	no free space for data blocks for the file 
+//	 	no free space for data blocks for the directory
+//		the file would be bigger than MaxFileSize
 //
 // 	Note that this implementation assumes there is no concurrent access
 //	to the file system!
@@ -202,6 +296,21 @@ FileSystem::SplitPath(char *FullPath, char *Path, char *filename)
 	printf("In SplitPath function ==>  %s ---> %s ----> %s\n", FullPath, Path, filename);
 }
 
+//----------------------------------------------------------------------
+// NameFits
+// 	Return TRUE if a path name, and the file name at the end of it,
+//	are short enough for SplitPath and the directory.
+//----------------------------------------------------------------------
+
+static bool
+NameFits(char *name)
+{
+    char *last = strrchr(name, '/');
+
+    return last != NULL && strlen(name) <= PathNameMaxLen
+			&& strlen(last) <= FileNameMaxLen;
+}
+
 bool
 FileSystem::Create(char *name, int initialSize, bool isDirectory)
 {
@@ -209,67 +318,125 @@ FileSystem::Create(char *name, int initialSize, bool isDirectory)
 	Directory *RootDirectory;
 	OpenFile *file;
 	Directory *directory;
-    PersistentBitmap *freeMap;
     FileHeader *hdr;
 	
     int sector;
     bool success;
 	int size = initialSize;
 	if(isDirectory) size = DirectoryFileSize;
-	char Path[256]; //255+1
-	char filename[10];	 //9+1
+	char Path[PathNameMaxLen + 1];
+	char filename[FileNameMaxLen + 1];
     DEBUG(dbgFile, "Creating file " << name << " size " << initialSize);
 
-    RootDirectory = new Directory(NumDirEntries);
+	if (!NameFits(name))
+		return FALSE;			// name too long
+
+	kernel->journal->Begin();
+    RootDirectory = new Directory();
     RootDirectory->FetchFrom(directoryFile);
 	
 	SplitPath(name, Path, filename);
 	DirecSector = RootDirectory->FindPath(Path);
-	if(DirecSector == -1) return FALSE;
+	if(DirecSector == -1) {
+		delete RootDirectory;
+		kernel->journal->End();
+		return FALSE;
+	}
 
 	file = new OpenFile(DirecSector);
-	directory = new Directory(NumDirEntries);
+	directory = new Directory();
 	directory->FetchFrom(file);
 		
     if (directory->Find(filename) != -1)
       success = FALSE;			// file is already in directory
     else {	
-        freeMap = new PersistentBitmap(freeMapFile,NumSectors);
-        sector = freeMap->FindAndSet();	// find a sector to hold the file header
+        sector = FreeMap()->AllocateHeader(DirecSector, isDirectory);
+					// find a sector to hold the file header
     	if (sector == -1) 		
             success = FALSE;		// no free block for file header 
         else if (!directory->Add(filename, sector, isDirectory))
-            success = FALSE;	// no space in directory
+            success = FALSE;	// name too long
 	else {
     	    hdr = new FileHeader;
-	    if (!hdr->Allocate(freeMap, size))
+	    if (!isDirectory && !hdr->AllocateSparse(size))
+		success = FALSE;	// file too big
+	    else if (isDirectory && !hdr->Allocate(freeMap, size, sector))
             	success = FALSE;	// no space on disk for data
-	    else {	
+	    else if (!file->Extend(directory->FileSize(), freeMap)) {
+		success = FALSE;	// no space for the directory to grow
+		hdr->Deallocate(freeMap);	// give back the data blocks
+	    } else {	
 	    	success = TRUE;
 		// everthing worked, flush all changes back to disk
     	    	hdr->WriteBack(sector);
 				cout<<name<<"--at--"<<sector<<" (1 = Directory, 0 = File)==>"<< isDirectory <<endl;		
     	    	directory->WriteBack(file);
-    	    	freeMap->WriteBack(freeMapFile);
+    	    	WriteBackFreeMap();
+			kernel->dentryCache->Enter(DirecSector, filename, sector,
+								isDirectory);
 			if(isDirectory)
 			{
 				delete file;
 				delete directory;
 				file = new OpenFile(sector);
-				directory = new Directory(NumDirEntries);
+				directory = new Directory();
 				directory->WriteBack(file);
 			}
 	    }
             delete hdr;
 	}
-       delete freeMap;
+	// undo only our own allocations: the free map is shared with
+	// other operations that may be under way, so it cannot simply
+	// be read back in
+	if (!success && sector != -1)
+	    freeMap->Clear(sector);
     }
 	delete file;
     delete RootDirectory;
 	delete directory;
+	kernel->journal->End();
     return success;
 }
 
+//----------------------------------------------------------------------
+// FileSystem::Fill
+// 	Allocate the data blocks a write to an open file needs: those of
+//	the sectors written that are holes, including any past the end of
+//	the file, which grows to take in the write.  Like Create, this is
+//	an operation on the file system's metadata, made atomic by the
+//	journal.  Return FALSE if the disk is too full.
+//
+//	"file" -- the file being written
+//	"position" -- where the write starts in the file
+//	"numBytes" -- the number of bytes written
+//----------------------------------------------------------------------
+
+bool
+FileSystem::Fill(OpenFile *file, int position, int numBytes)
+{
+    bool success;
+
+    kernel->journal->Begin();
+    success = file->Fill(position, numBytes, FreeMap());
+    if (success)
+	WriteBackFreeMap();			// flush to disk
+    kernel->journal->End();
+    return success;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::NumFree
+// 	Return the number of sectors that are free on the disk.  No journal
+//	operation is needed to look, since nothing is changed; the answer
+//	may be out of date as soon as another thread allocates or frees.
+//----------------------------------------------------------------------
+
+int
+FileSystem::NumFree()
+{
+    return FreeMap()->NumClear();
+}
+
 //----------------------------------------------------------------------
 // FileSystem::Open
 // 	Open a file for reading and writing.  
@@ -283,7 +450,7 @@ FileSystem::Create(char *name, int initialSize, bool isDirectory)
 OpenFile *
 FileSystem::Open(char *name)
 { 
-    Directory *directory = new Directory(NumDirEntries);
+    Directory *directory = new Directory();
     OpenFile *openFile = NULL;
     int sector;
 
@@ -314,54 +481,47 @@ bool
 FileSystem::Remove(char *name)
 { 
     Directory *directory;
-    PersistentBitmap *freeMap;
     FileHeader *fileHdr;
-    int sector;
+    int sector, dirSector;
     
 	OpenFile *file;
-	char Path[256];
-	char filename[10];
+	char Path[PathNameMaxLen + 1];
+	char filename[FileNameMaxLen + 1];
+	if (!NameFits(name))
+		return FALSE;			// no such file
 	SplitPath(name, Path, filename);
 
-    directory = new Directory(NumDirEntries);
+	kernel->journal->Begin();
+    directory = new Directory();
     directory->FetchFrom(directoryFile);
     sector = directory->FindPath(name);
-    if (sector == -1) {
+   	dirSector = directory->FindPath(Path);
+    if (sector == -1 || dirSector == -1) {
        delete directory;
+       kernel->journal->End();
        return FALSE;			 // file not found 
     }
     fileHdr = new FileHeader;
     fileHdr->FetchFrom(sector);
 
-    freeMap = new PersistentBitmap(freeMapFile,NumSectors);
-
-    fileHdr->Deallocate(freeMap);  		// remove data blocks
+    fileHdr->Deallocate(FreeMap());  		// remove data blocks
     freeMap->Clear(sector);			// remove header block
+    kernel->inodeTable->Remove(sector);	// drop its in-core copy
    // directory->Remove(name);
    //
-   	sector = directory->FindPath(Path);
-	if(sector == -1){
-		delete directory;
-		return FALSE;
-	}
-	
-	file = new OpenFile(sector);
+	file = new OpenFile(dirSector);
 	directory->FetchFrom(file);
 	directory->Remove(filename);
-	FileHeader *iterHdr = fileHdr;
-	int iterSector = sector;
-	for(iterHdr = fileHdr; iterHdr == NULL; iterHdr = iterHdr->getNextHeader()){
-		freeMap->Clear(iterSector);
-		iterSector = iterHdr->getNextSector();
-	}
+    kernel->dentryCache->Enter(dirSector, filename, -1, FALSE);
+    kernel->dentryCache->InvalidateDirectory(sector);	// if it was one
 
-    freeMap->WriteBack(freeMapFile);		// flush to disk
+    WriteBackFreeMap();				// flush to disk
     directory->WriteBack(file);        // flush to disk
 
 	delete file;
     delete fileHdr;
     delete directory;
-    delete freeMap;
+    kernel->journal->End();
     return TRUE;
 } 
 
@@ -374,7 +534,7 @@ FileSystem::Remove(char *name)
 void
 FileSystem::List(char *name)
 {
-	Directory *directory = new Directory(NumDirEntries);
+	Directory *directory = new Directory();
 	OpenFile *file = NULL;
 
 
@@ -392,40 +552,31 @@ FileSystem::List(char *name)
 void
 FileSystem::RecursiveList(char *name)
 {
-	Directory *Rootdirectory = new Directory(NumDirEntries);
-	Directory *Leafdirectory = new Directory(NumDirEntries);
+	Directory *directory = new Directory();
 	OpenFile *file = NULL;
-	int sector;
-	char CombinePath[256];
+	DirectoryEntry entry;
+	int sector, position = 0;
+	char CombinePath[PathNameMaxLen + FileNameMaxLen + 1];
 
 	if(strlen(name) == 1) name[0] = '\0';
 
-	strcpy(CombinePath, name);
-	Rootdirectory->FetchFrom(directoryFile);
-	sector = Rootdirectory->FindPath(name);
+	directory->FetchFrom(directoryFile);
+	sector = directory->FindPath(name);
 
 	if(sector >= 0) file = new OpenFile(sector);
 
-	Rootdirectory->FetchFrom(file);
-	DirectoryEntry *RootEntry = Rootdirectory->getTable();
-	for(int i = 0; i < NumDirEntries; i++){
-		if(RootEntry[i].inUse){
-			strcat(CombinePath, RootEntry[i].name);			
-		
-		if(RootEntry[i].isDirectory) printf("--%s--Directory\n", CombinePath);
-		else printf("--%s--File\n", CombinePath);
-		if(RootEntry[i].isDirectory){
-			OpenFile *file_recur = new OpenFile(RootEntry[i].sector);
-			Leafdirectory->FetchFrom(file_recur);
-			delete file_recur;
-			RecursiveList(CombinePath); 
-		}
+	directory->FetchFrom(file);
+	while (directory->NextEntry(&position, &entry)) {
 		strcpy(CombinePath, name);
-		}
+		strcat(CombinePath, entry.name);
+
+		if(entry.isDirectory) printf("--%s--Directory\n", CombinePath);
+		else printf("--%s--File\n", CombinePath);
+		if(entry.isDirectory && strlen(CombinePath) <= PathNameMaxLen)
+			RecursiveList(CombinePath);
 	}
 	if(file != NULL) delete file;
-	delete Rootdirectory;
-	delete Leafdirectory;
+	delete directory;
 }
 
 //----------------------------------------------------------------------
@@ -443,8 +594,7 @@ FileSystem::Print()
 {
     FileHeader *bitHdr = new FileHeader;
     FileHeader *dirHdr = new FileHeader;
-    PersistentBitmap *freeMap = new PersistentBitmap(freeMapFile,NumSectors);
-    Directory *directory = new Directory(NumDirEntries);
+    Directory *directory = new Directory();
 
     printf("Bit map file header:\n");
     bitHdr->FetchFrom(FreeMapSector);
@@ -454,14 +604,13 @@ FileSystem::Print()
     dirHdr->FetchFrom(DirectorySector);
     dirHdr->Print();
 
-    freeMap->Print();
+    FreeMap()->Print();
 
     directory->FetchFrom(directoryFile);
     directory->Print();
 
     delete bitHdr;
     delete dirHdr;
-    delete freeMap;
     delete directory;
 } 
 
@@ -35,21 +35,27 @@
 // sectors, so that they can be located on boot-up.
 #define FreeMapSector 		0
 #define DirectorySector 	1
+#define SuperblockSector	2	// what kind of file system is on
+					// the disk; the journal follows it
 
-// Initial file sizes for the bitmap and directory; until the file system
-// supports extensible files, the directory size sets the maximum number 
-// of files that can be loaded onto the disk.
+// Initial file sizes for the bitmap and directory; a directory starts
+// out with its header block and a single bucket, and grows as files
+// are added to it.
 #define FreeMapFileSize 	(NumSectors / BitsInByte)
-#define NumDirEntries 		64
-#define DirectoryFileSize 	(sizeof(DirectoryEntry) * NumDirEntries)
+#define DirectoryFileSize 	(2 * DirBlockSize)
+
+#define SuperblockMagic		0x53420001	// "SB", format 1
 
 #ifndef FS_H
 #define FS_H
 
 #include "copyright.h"
 #include "sysdep.h"
+#include "disk.h"
 #include "openfile.h"
 
+class PersistentBitmap;
+
 #ifdef FILESYS_STUB 		// Temporarily implement file system calls as 
 				// calls to UNIX, until the real file system
 				// implementation is available
@@ -79,6 +85,23 @@ class FileSystem {
 };
 
 #else // FILESYS
+// The superblock says what is on the disk, and how much of the free map
+// file has been written.  Formatting only writes the sectors of the free
+// map holding set bits; the rest are written as bits in them get set,
+// in order, so they are always the first "mapSectors" sectors of the
+// file, and the others read as all clear without being read.  It takes
+// one sector on disk, and is written through the journal along with the
+// free map.
+
+class Superblock {
+  public:
+    int magic;				// SuperblockMagic
+    int headerVersion;			// FileHeaderVersion of the headers
+    int mapSectors;			// Sectors of the free map file
+					// written so far
+    int unused[(SectorSize / sizeof(int)) - 3];	// pad to a sector
+};
+
 class FileSystem {
   public:
     FileSystem(bool format);		// Initialize the file system.
@@ -97,13 +120,28 @@ class FileSystem {
 
     bool Remove(char *name);  		// Delete a file (UNIX unlink)
 
+    bool Fill(OpenFile *file, int position, int numBytes);
+					// Allocate space for a write to
+					// an open file
+    int NumFree();			// Number of free sectors on disk
+
     void List(char *name);			// List all the files in the file system
 	void RecursiveList(char *name);  	// List all the files in the file system in RecursiveList
     void Print();			// List all the files and their contents
 
   private:
+   Superblock *superblock;		// Read in when the disk is mounted
    OpenFile* freeMapFile;		// Bit map of free disk blocks,
-					// represented as a file
+					// represented as a file; opened
+					// once it is first needed
+   PersistentBitmap *freeMap;		// The bit map itself, kept in
+					// memory once it is first needed
+
+   PersistentBitmap *FreeMap();		// Return freeMap, reading it in
+					// if this is the first use
+   void WriteBackFreeMap();		// Write back the changed sectors of
+					// freeMap, and the superblock if
+					// more of its file was written
    OpenFile* directoryFile;		// "Root" directory -- list of 
 					// file names, represented as a file
 };
@@ -0,0 +1,111 @@
+// flusher.cc
+//	Routines for the flusher thread, which writes back what the file
+//	system holds in memory once it has been there for a while.
+//
+//	A flush is the same as the Sync system call: the write-behind
+//	buffers are written out first, so that their sectors get allocated
+//	and dirtied in the cache; then the journal commits the running
+//	transaction, and the dirty sectors that are not already in the log
+//	are written back, in sector order, a run of consecutive sectors
+//	per disk request.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "flusher.h"
+#include "inodetable.h"
+#include "journal.h"
+#include "main.h"
+
+//----------------------------------------------------------------------
+// Flusher::Flusher
+// 	Initialize the flusher, with nothing to flush.
+//----------------------------------------------------------------------
+
+Flusher::Flusher()
+{
+    wakeup = new Semaphore("flusher wakeup", 0);
+    dirtySince = -1;
+    wanted = idle = FALSE;
+}
+
+//----------------------------------------------------------------------
+// Flusher::~Flusher
+// 	De-allocate the flusher.
+//----------------------------------------------------------------------
+
+Flusher::~Flusher()
+{
+    delete wakeup;
+}
+
+//----------------------------------------------------------------------
+// Flusher::Dirtied
+// 	Called whenever the file system writes something that is not on
+//	disk yet.  Start the clock if nothing was waiting; wake up the
+//	flusher if what was has waited FlushInterval ticks.
+//----------------------------------------------------------------------
+
+void
+Flusher::Dirtied()
+{
+    int now = kernel->stats->totalTicks;
+
+    if (dirtySince == -1)
+	dirtySince = now;
+    else if (!wanted && now - dirtySince >= FlushInterval) {
+	wanted = TRUE;
+	wakeup->V();
+    }
+}
+
+//----------------------------------------------------------------------
+// Flusher::FlushBehind
+// 	Called from Kernel::PrepareToEnd, when no thread is ready to run,
+//	with interrupts off.  Data left in a write-behind buffer would
+//	never be written if its file is not closed (say, the program that
+//	wrote it exited), so wake up the flusher to write out all of them,
+//	and return TRUE if we did.
+//----------------------------------------------------------------------
+
+bool
+Flusher::FlushBehind()
+{
+    ASSERT(kernel->interrupt->getLevel() == IntOff);
+    if (wanted || !kernel->inodeTable->Pending())
+	return FALSE;
+    wanted = idle = TRUE;
+    wakeup->V();
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Flusher::Run
+// 	The flusher thread.  Wait to be woken up by Dirtied or FlushBehind,
+//	and then write everything back (but only the write-behind buffers
+//	that have held data for FlushInterval ticks, if the machine is not
+//	idle; see InodeTable::Flush).  The clock is reset before the flush, so
+//	that what is written while it goes on waits for the next one.
+//
+//	"data" -- the flusher
+//----------------------------------------------------------------------
+
+void
+Flusher::Run(void *data)
+{
+    Flusher *_this = (Flusher *) data;
+    int age;
+
+    for (;;) {
+	_this->wakeup->P();
+	age = _this->idle ? 0 : FlushInterval;
+	_this->dirtySince = -1;
+	_this->wanted = _this->idle = FALSE;
+	DEBUG(dbgFile, "Flusher writing back");
+	kernel->stats->numFlusherRuns++;
+	kernel->inodeTable->Flush(age);
+	kernel->journal->Sync();
+    }
+}
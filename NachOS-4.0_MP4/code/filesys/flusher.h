@@ -0,0 +1,56 @@
+// flusher.h
+//	Data structures for the flusher -- a kernel thread that writes
+//	back, from time to time, what the file system has been holding
+//	in memory: the data in write-behind buffers, the running journal
+//	transaction, and the dirty sectors in the sector cache.
+//
+//	Without it, these only reach the disk when memory runs short, when
+//	the machine goes idle, or when a file is closed; a busy machine
+//	can keep written data in memory for as long as it runs.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef FLUSHER_H
+#define FLUSHER_H
+
+#include "synch.h"
+
+#define FlushInterval		10000000	// ticks written data may wait
+						// before the flusher is woken
+
+// The following class defines the flusher.  There is no timer to wake
+// it up with (the alarm is turned off the first time the machine goes
+// idle), so the file system tells it whenever something is written;
+// the first write after a flush starts the clock, and the first one
+// FlushInterval ticks later wakes the flusher up.  A machine that stops
+// writing goes idle sooner or later; the flusher is then woken up to
+// write out the write-behind buffers, and the rest is written back by
+// the journal and the sector cache (see Kernel::PrepareToEnd).
+
+class Flusher {
+  public:
+    Flusher();				// Initialize the flusher
+    ~Flusher();				// De-allocate it
+
+    void Dirtied();			// Something was written that is
+					// not on disk yet
+    bool FlushBehind();			// Have the flusher write out the
+					// write-behind buffers, if they hold
+					// anything.  Called with interrupts
+					// off, when no thread is ready to run.
+    static void Run(void *data);	// Flush when woken up, forever;
+					// forked by Kernel::Initialize
+
+  private:
+    Semaphore *wakeup;			// Wakes up the flusher thread
+    int dirtySince;			// When the oldest write not yet
+					// flushed was made; -1 if none
+    bool wanted;			// Has the flusher been woken?
+    bool idle;				// ...by FlushBehind?
+};
+
+#endif // FLUSHER_H
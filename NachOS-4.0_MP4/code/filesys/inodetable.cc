@@ -0,0 +1,358 @@
+// inodetable.cc
+//	Routines to share in-core file headers among open files.
+//
+//	An inode is created the first time its header sector is opened,
+//	and is reference counted by the OpenFiles that use it.  Whoever
+//	changes the header writes it back right away, so the in-core copy
+//	is never newer than the disk.  When the last OpenFile goes away,
+//	the inode stays in the table, so that opening the file again costs
+//	no header I/O.  Inodes nobody uses are reclaimed once the table
+//	holds more than NumInodes of them.
+//
+//	An open inode may also have a write-behind buffer (see openfile.cc).
+//	There are at most NumWriteBehind of these; a file that wants one
+//	when they are all taken gets the buffer of a file that is not
+//	using its own, or else has another file's buffer written out to
+//	free it up.  The buffer is given back on the last close.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "inodetable.h"
+#include "filehdr.h"
+#include "openfile.h"
+#include "debug.h"
+#include "main.h"
+
+//----------------------------------------------------------------------
+// InodeTable::InodeTable
+// 	Initialize an empty inode table.
+//----------------------------------------------------------------------
+
+InodeTable::InodeTable()
+{
+    for (int i = 0; i < InodeHashSize; i++)
+	hashTable[i] = NULL;
+    numInodes = 0;
+    numBuffers = 0;
+    lock = new Lock("inode table lock");
+}
+
+//----------------------------------------------------------------------
+// InodeTable::~InodeTable
+// 	De-allocate the inode table, and every inode still in it.
+//----------------------------------------------------------------------
+
+InodeTable::~InodeTable()
+{
+    for (int i = 0; i < InodeHashSize; i++) {
+	while (hashTable[i] != NULL) {
+	    Inode *inode = hashTable[i];
+	    hashTable[i] = inode->next;
+	    delete [] inode->pending;
+	    delete inode->bufferLock;
+	    delete inode->hdr;
+	    delete inode;
+	}
+    }
+    delete lock;
+}
+
+//----------------------------------------------------------------------
+// InodeTable::Open
+// 	Return the in-core inode for the file header at "sector", with one
+//	more reference to it.  The header is only read from disk if it is
+//	not in the table already.
+//
+//	"sector" -- the location on disk of the file header
+//----------------------------------------------------------------------
+
+Inode *
+InodeTable::Open(int sector)
+{
+    Inode *inode;
+
+    lock->Acquire();
+    inode = Find(sector);
+    if (inode == NULL) {
+	DEBUG(dbgFile, "Reading inode " << sector);
+	inode = new Inode;
+	inode->sector = sector;
+	inode->refCount = 0;
+	inode->removed = FALSE;
+	inode->pending = NULL;
+	inode->pendingStart = inode->pendingBytes = 0;
+	inode->pendingSince = 0;
+	inode->writeError = FALSE;
+	inode->bufferLock = new Lock("write-behind lock");
+	inode->hdr = new FileHeader;
+	inode->hdr->FetchFrom(sector);
+	inode->next = hashTable[sector % InodeHashSize];
+	hashTable[sector % InodeHashSize] = inode;
+	numInodes++;
+    }
+    inode->refCount++;
+    Reclaim();
+    lock->Release();
+    return inode;
+}
+
+//----------------------------------------------------------------------
+// InodeTable::Close
+// 	Drop a reference to an inode.  On the last reference, give back
+//	the write-behind buffer (which the OpenFile has flushed); an inode
+//	whose file was removed is freed right away.
+//
+//	"inode" -- the inode, as returned by Open
+//----------------------------------------------------------------------
+
+void
+InodeTable::Close(Inode *inode)
+{
+    lock->Acquire();
+    ASSERT(inode->refCount > 0);
+    inode->refCount--;
+    if (inode->refCount == 0) {
+	DropBuffer(inode);
+	if (inode->removed)
+	    Free(inode);
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// InodeTable::Remove
+// 	Forget the inode for a file that has been deleted, so that a new
+//	file whose header lands on the same sector is read afresh.  If the
+//	file is still open, the inode lives on until it is closed; what is
+//	waiting in its write-behind buffer will never be written.
+//
+//	"sector" -- the location on disk of the deleted file's header
+//----------------------------------------------------------------------
+
+void
+InodeTable::Remove(int sector)
+{
+    Inode *inode;
+
+    lock->Acquire();
+    inode = Find(sector);
+    if (inode != NULL) {
+	Unlink(inode);
+	inode->removed = TRUE;
+	inode->pendingBytes = 0;
+	if (inode->refCount == 0)
+	    Free(inode);
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// InodeTable::GetBuffer
+// 	Give an open inode a write-behind buffer.  If there are already
+//	NumWriteBehind of them, take one that is empty, writing out another
+//	file's buffer first if there is no such buffer.
+//
+//	The caller holds the inode's buffer lock.
+//
+//	"inode" -- the inode, with no buffer yet
+//----------------------------------------------------------------------
+
+void
+InodeTable::GetBuffer(Inode *inode)
+{
+    Inode *other;
+
+    lock->Acquire();
+    while (inode->pending == NULL) {
+	if (numBuffers >= NumWriteBehind
+			&& (other = FindBuffer(inode, FALSE, 0)) != NULL) {
+	    inode->pending = other->pending;	// take over an empty one
+	    other->pending = NULL;
+	} else if (numBuffers >= NumWriteBehind
+			&& (other = FindBuffer(inode, TRUE, 0)) != NULL) {
+	    other->refCount++;			// empty one out first
+	    lock->Release();
+	    FlushFile(other);
+	    lock->Acquire();
+	} else {
+	    inode->pending = new char[WriteBehindSize];
+	    numBuffers++;
+	}
+    }
+    inode->pendingBytes = 0;
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// InodeTable::Flush
+// 	Write out what is waiting in the write-behind buffers: in all of
+//	them, before the machine halts or for the Sync system call (with
+//	"age" 0), or only in those that have held data for "age" ticks,
+//	for the flusher.  A buffer that is being filled or written out
+//	right now is skipped: its writer flushes it soon enough, and we
+//	would only wait for it (perhaps forever, since the writer takes
+//	the buffer's lock back each time it lets go of it).
+//----------------------------------------------------------------------
+
+void
+InodeTable::Flush(int age)
+{
+    Inode *inode;
+
+    lock->Acquire();
+    while ((inode = FindBuffer(NULL, TRUE, age)) != NULL) {
+	inode->refCount++;		// keep it while we let go of the lock
+	lock->Release();
+	FlushFile(inode);
+	lock->Acquire();
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// InodeTable::Pending
+// 	Return TRUE if some write-behind buffer holds data that Flush
+//	would write out now.  Called with interrupts off, when the machine
+//	is idle, so we cannot wait for the table lock -- and need not,
+//	since no other thread can run.
+//----------------------------------------------------------------------
+
+bool
+InodeTable::Pending()
+{
+    return FindBuffer(NULL, TRUE, 0) != NULL;
+}
+
+//----------------------------------------------------------------------
+// InodeTable::Find
+// 	Return the inode for the header at "sector", or NULL.
+//----------------------------------------------------------------------
+
+Inode *
+InodeTable::Find(int sector)
+{
+    Inode *inode;
+
+    for (inode = hashTable[sector % InodeHashSize]; inode != NULL;
+						inode = inode->next)
+	if (inode->sector == sector)
+	    return inode;
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// InodeTable::Unlink
+// 	Take an inode out of the table, without freeing it.
+//----------------------------------------------------------------------
+
+void
+InodeTable::Unlink(Inode *inode)
+{
+    Inode **p = &hashTable[inode->sector % InodeHashSize];
+
+    while (*p != inode) {
+	ASSERT(*p != NULL);
+	p = &(*p)->next;
+    }
+    *p = inode->next;
+    inode->next = NULL;
+    numInodes--;
+}
+
+//----------------------------------------------------------------------
+// InodeTable::Reclaim
+// 	If the table has grown past NumInodes, free one inode that no
+//	OpenFile refers to (if there is one).
+//----------------------------------------------------------------------
+
+void
+InodeTable::Reclaim()
+{
+    if (numInodes <= NumInodes)
+	return;
+    for (int i = 0; i < InodeHashSize; i++)
+	for (Inode *inode = hashTable[i]; inode != NULL; inode = inode->next)
+	    if (inode->refCount == 0) {
+		Unlink(inode);
+		Free(inode);
+		return;
+	    }
+}
+
+//----------------------------------------------------------------------
+// InodeTable::Free
+// 	De-allocate an inode that is out of the table (or about to be).
+//----------------------------------------------------------------------
+
+void
+InodeTable::Free(Inode *inode)
+{
+    ASSERT(inode->refCount == 0);
+    DropBuffer(inode);
+    delete inode->bufferLock;
+    delete inode->hdr;
+    delete inode;
+}
+
+//----------------------------------------------------------------------
+// InodeTable::FindBuffer
+// 	Return an inode in the table, other than "except", that has a
+//	write-behind buffer with data in it (if "full"), or an empty one
+//	(if not); NULL if there is none.  Data must have been waiting for
+//	at least "age" ticks, and nobody may be using the buffer right now
+//	(we would only wait for them, or pull it out from under them).
+//----------------------------------------------------------------------
+
+Inode *
+InodeTable::FindBuffer(Inode *except, bool full, int age)
+{
+    int now = kernel->stats->totalTicks;
+
+    for (int i = 0; i < InodeHashSize; i++)
+	for (Inode *inode = hashTable[i]; inode != NULL; inode = inode->next)
+	    if (inode != except && inode->pending != NULL
+			&& (inode->pendingBytes > 0) == full
+			&& (!full || now - inode->pendingSince >= age)
+			&& !inode->bufferLock->IsHeld())
+		return inode;
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// InodeTable::FlushFile
+// 	Write out the write-behind buffer of an inode, through an OpenFile
+//	of our own.  The caller has taken a reference to the inode while
+//	holding the table lock, so that it cannot be freed (and its header
+//	sector reused) once the lock is let go; the OpenFile takes over
+//	that reference, and drops it when it is deleted.  Called without
+//	the table lock, which closing the file needs.
+//
+//	"inode" -- the inode, with a reference held for us
+//----------------------------------------------------------------------
+
+void
+InodeTable::FlushFile(Inode *inode)
+{
+    OpenFile *file = new OpenFile(inode);
+
+    delete file;			// flushes; the buffer stays with
+}					// the file's other OpenFiles
+
+//----------------------------------------------------------------------
+// InodeTable::DropBuffer
+// 	De-allocate the write-behind buffer of an inode, if it has one.
+//----------------------------------------------------------------------
+
+void
+InodeTable::DropBuffer(Inode *inode)
+{
+    if (inode->pending == NULL)
+	return;
+    delete [] inode->pending;
+    inode->pending = NULL;
+    inode->pendingBytes = 0;
+    numBuffers--;
+}
@@ -0,0 +1,112 @@
+// inodetable.h
+//	Data structures for the table of in-core inodes -- the file
+//	headers of files that are open, shared by every OpenFile of
+//	the same file.
+//
+//	Without the table, each OpenFile reads its own copy of the file
+//	header on every open.
+//	With it, the header is read once, and stays in memory while any
+//	OpenFile refers to it (and a while after, in case the file is
+//	opened again).
+//
+//	The inode also holds the file's write-behind buffer, where small
+//	writes collect until there are enough of them to be worth writing
+//	out together.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef INODETABLE_H
+#define INODETABLE_H
+
+#include "synch.h"
+#include "disk.h"
+
+class FileHeader;
+
+#define NumInodes 		64	// in-core inodes kept around, even
+					// when no file has them open
+#define InodeHashSize 		32	// number of hash buckets
+#define WriteBehindSectors	16	// sectors in a write-behind buffer
+#define WriteBehindSize		(WriteBehindSectors * SectorSize)
+#define NumWriteBehind		8	// most write-behind buffers at once
+#define WriteBehindReserve	(2 * NumWriteBehind * WriteBehindSectors)
+					// free sectors below which writes
+					// are no longer held back
+
+// The following class defines an in-core inode: a file header in memory,
+// along with the bookkeeping to share it.
+//
+// Internal data structures kept public so that InodeTable and OpenFile
+// operations can access them directly.
+
+class Inode {
+  public:
+    int sector;				// Disk sector holding the file header
+    int refCount;			// Number of OpenFiles using this inode
+    bool removed;			// File deleted while still open; the
+					//   inode goes away on the last close
+    FileHeader *hdr;			// The file header itself
+    char *pending;			// Write-behind buffer (WriteBehindSize
+					//   bytes), NULL if the file has none
+    int pendingStart;			// Position in the file of the data
+    int pendingBytes;			//   waiting in the buffer, and how
+					//   much there is
+    int pendingSince;			// When the buffer was last empty
+    bool writeError;			// Data in the buffer was lost for
+					//   want of disk space, and no Flush
+					//   has reported it yet
+    Lock *bufferLock;			// Mutual exclusion on the buffer,
+					//   which the flusher thread (and
+					//   other files) may write out
+    Inode *next;			// Next inode in the same hash bucket
+};
+
+// The following class defines the in-core inode table, keyed by the
+// sector number of the file header.
+
+class InodeTable {
+  public:
+    InodeTable();			// Initialize an empty table
+    ~InodeTable();			// De-allocate the table
+
+    Inode *Open(int sector);		// Return the inode for the header
+					//  at "sector", fetching it from
+					//  disk if it is not in memory, and
+					//  add a reference to it
+    void Close(Inode *inode);		// Drop a reference
+    void Remove(int sector);		// The file at "sector" has been
+					//  deleted; forget its inode
+
+    void GetBuffer(Inode *inode);	// Give an open inode a write-behind
+					//  buffer, flushing another file's
+					//  if there are too many
+    void Flush(int age);		// Write out every write-behind
+					//  buffer whose data has waited
+					//  "age" ticks
+    bool Pending();			// Does any write-behind buffer hold
+					//  data?  Called with interrupts off
+
+  private:
+    Inode *hashTable[InodeHashSize];	// Chains of inodes, by sector
+    int numInodes;			// Number of inodes in the table
+    int numBuffers;			// Number of write-behind buffers
+    Lock *lock;				// Mutual exclusion on the table
+
+    Inode *Find(int sector);		// Find the inode for "sector"
+    void Unlink(Inode *inode);		// Take an inode off its chain
+    void Reclaim();			// Drop one inode nobody uses, if
+					//  the table is over NumInodes
+    void Free(Inode *inode);		// De-allocate an inode
+    Inode *FindBuffer(Inode *except, bool full, int age);
+					// An inode with a write-behind
+					//  buffer, with or without data
+    void FlushFile(Inode *inode);	// Flush the buffer of one file,
+					//  and drop a reference to it
+    void DropBuffer(Inode *inode);	// De-allocate a write-behind buffer
+};
+
+#endif // INODETABLE_H
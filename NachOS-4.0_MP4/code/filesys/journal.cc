@@ -0,0 +1,601 @@
+// journal.cc
+//	Routines to log changes to the file system's metadata.  See
+//	journal.h for the overall scheme, and for the format of the log.
+//
+//	The running transaction is the list of sectors logged since the
+//	last commit, followed by the list of sectors revoked.  A sector
+//	is listed once, however often it is written: the log gets the
+//	contents it has when the transaction commits.
+//
+//	The log is never wrapped around.  A commit that does not fit in
+//	what is left of it first writes everything home and starts the log
+//	over.  Transactions are numbered, and the header says which number
+//	to expect first, so stale transactions further on in the log are
+//	never mistaken for new ones.
+//
+//	Checkpointing only when the log is full means a clean shutdown
+//	leaves the log full of transactions, which the next mount reads
+//	back in; in return, an operation costs one sequential write to the
+//	log, rather than that and a write of every sector it touched.
+//
+//	The committer thread is woken up, like the read ahead worker in
+//	sectorcache.cc, because the idle loop cannot wait for the disk
+//	itself.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "journal.h"
+#include "sectorcache.h"
+#include "flusher.h"
+#include "synchdisk.h"
+#include "main.h"
+
+//----------------------------------------------------------------------
+// Journal::Journal
+// 	Initialize the journal, with an empty running transaction, and
+//	start the thread that commits transactions when the machine goes
+//	idle.  The log itself is set up by Format or Recover.
+//
+//	"cache" -- the sector cache holding the sectors logged
+//	"disk" -- the disk the log is on
+//----------------------------------------------------------------------
+
+Journal::Journal(SectorCache *cache, SynchDisk *disk)
+{
+    this->cache = cache;
+    synchDisk = disk;
+    lock = new Lock("journal lock");
+    changed = new Condition("journal changed");
+    holders = new List<Thread *>;
+    entries = new int[JournalMaxEntries];
+    numBlocks = numEntries = 0;
+    inTransaction = new Bitmap(NumSectors);
+    inLog = new Bitmap(NumSectors);
+    sequence = 1;
+    head = 0;
+    committing = commitWanted = FALSE;
+    wakeup = new Semaphore("journal wakeup", 0);
+    image = new char[(1 + JournalLogSectors) * SectorSize];
+    slots = new char *[1 + JournalLogSectors];
+    for (int i = 0; i <= JournalLogSectors; i++)
+	slots[i] = &image[i * SectorSize];
+    memset(image, 0, (1 + JournalLogSectors) * SectorSize);
+
+    Thread *t = new Thread("journal committer", 1);
+
+    t->Fork(Journal::Committer, this);
+}
+
+//----------------------------------------------------------------------
+// Journal::~Journal
+// 	De-allocate the journal.  As for the sector cache, the committer
+//	thread is left waiting on "wakeup", which we don't deallocate.
+//----------------------------------------------------------------------
+
+Journal::~Journal()
+{
+    delete [] slots;
+    delete [] image;
+    delete inLog;
+    delete inTransaction;
+    delete [] entries;
+    delete holders;
+    delete changed;
+    delete lock;
+}
+
+//----------------------------------------------------------------------
+// Journal::Format
+// 	Set up an empty log on a disk being formatted.  The first sector
+//	of the log is cleared along with the header, in case the disk
+//	holds the log of an earlier file system.
+//
+//	If it does, the new log also numbers its transactions after any
+//	the old one can hold: otherwise, a stale transaction that happens
+//	to lie right after a new one could pass for its successor.
+//----------------------------------------------------------------------
+
+void
+Journal::Format()
+{
+    JournalHeader *header = (JournalHeader *) slots[0];
+
+    lock->Acquire();
+    synchDisk->ReadSector(JournalSector, slots[0]);
+    if (header->magic == JournalMagic && header->sequence > 0)
+	sequence = header->sequence + JournalLogSectors;
+    else
+	sequence = 1;
+    head = 0;
+    memset(slots[1], 0, SectorSize);
+    WriteHeader();
+    synchDisk->WriteSector(JournalSector + 1, slots[1]);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::Recover
+// 	Replay the log, when the disk is mounted.  Every transaction found
+//	complete in the log, in sequence, is loaded into the sector cache,
+//	and new transactions are committed after the last one.  Whether
+//	Nachos crashed or not makes no difference: either way, the log is
+//	the latest word on the sectors in it.
+//
+//	Transactions are replayed newest first, so that each sector is
+//	only loaded once, with its last contents; a sector revoked by a
+//	transaction is not loaded from it or from any transaction before it.
+//----------------------------------------------------------------------
+
+void
+Journal::Recover()
+{
+    JournalHeader *header = (JournalHeader *) slots[0];
+    int starts[JournalLogSectors / 2];	// a transaction is >= 2 sectors
+    int numTransactions = 0, numReplayed = 0;
+    int length;
+
+    lock->Acquire();
+    synchDisk->ReadSectors(JournalSector, slots, 2);
+    if (header->magic != JournalMagic || header->size != JournalLogSectors) {
+	cerr << "Disk has no journal; format it again with -f\n";
+	Abort();
+    }
+    sequence = header->sequence;
+    head = 0;
+    while (head < JournalLogSectors && Check(head, &length)) {
+	starts[numTransactions++] = head;
+	head += length;
+	sequence++;
+    }
+    if (numTransactions > 0) {
+	Bitmap *done = new Bitmap(NumSectors);
+
+	for (int i = numTransactions - 1; i >= 0; i--)
+	    numReplayed += Replay(starts[i], done);
+	delete done;
+	DEBUG(dbgFile, "Replayed " << numTransactions << " transactions, "
+			<< numReplayed << " sectors, from the journal");
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::Begin
+// 	Start an operation on the file system's metadata.  Sectors the
+//	current thread writes through the journal until the matching End
+//	are logged, in the running transaction.
+//
+//	If the running transaction is already large, commit it first (unless
+//	this thread is inside an operation already; then it has to wait for
+//	the next Begin).
+//----------------------------------------------------------------------
+
+void
+Journal::Begin()
+{
+    lock->Acquire();
+    if (numEntries >= JournalBatch
+		&& !holders->IsInList(kernel->currentThread))
+	Commit();
+    holders->Append(kernel->currentThread);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::End
+// 	The current thread's operation is complete.  It is committed along
+//	with the rest of its transaction, later.
+//----------------------------------------------------------------------
+
+void
+Journal::End()
+{
+    lock->Acquire();
+    holders->Remove(kernel->currentThread);
+    if (holders->IsEmpty())
+	changed->Broadcast(lock);	// a commit may be waiting
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::InOperation
+// 	Return TRUE if the current thread is between Begin and End: what
+//	it writes now is part of an operation, and must not be put off
+//	until after the operation is over.
+//----------------------------------------------------------------------
+
+bool
+Journal::InOperation()
+{
+    bool inside;
+
+    lock->Acquire();
+    inside = holders->IsInList(kernel->currentThread);
+    lock->Release();
+    return inside;
+}
+
+//----------------------------------------------------------------------
+// Journal::WriteSector
+// 	Write the contents of a buffer into a disk sector, through the
+//	sector cache.  Inside an operation, or if the log already has a
+//	copy of the sector, the sector is also logged in the running
+//	transaction, and its buffer is kept from going home until the
+//	transaction is committed.
+//
+//	"sectorNumber" -- the disk sector to be written
+//	"data" -- the new contents of the disk sector
+//----------------------------------------------------------------------
+
+void
+Journal::WriteSector(int sectorNumber, char* data)
+{
+    kernel->flusher->Dirtied();		// it will have to go to disk
+    lock->Acquire();
+    if (!holders->IsInList(kernel->currentThread)
+		&& !inLog->Test(sectorNumber)
+		&& !inTransaction->Test(sectorNumber)) {
+	lock->Release();
+	cache->WriteSector(sectorNumber, data);
+	return;
+    }
+
+    // a sector written after it was freed is in use again
+    for (int i = numBlocks; i < numEntries; i++)
+	if (entries[i] == sectorNumber) {
+	    entries[i] = entries[--numEntries];
+	    break;
+	}
+
+    if (inTransaction->Test(sectorNumber)) {
+	cache->WriteSector(sectorNumber, data);	// already pinned
+	lock->Release();
+	return;
+    }
+    if (numEntries == JournalMaxEntries)
+	Overflow();
+    inTransaction->Mark(sectorNumber);
+    entries[numEntries] = entries[numBlocks];	// keep revokes at the end
+    entries[numBlocks++] = sectorNumber;
+    numEntries++;
+    cache->WritePinned(sectorNumber, data);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::Revoke
+// 	A sector has been freed, so it may be reused for a file's data,
+//	which is not logged.  If the log has (or is going to have) a copy
+//	of the sector, record that the copy must not be replayed.
+//
+//	"sectorNumber" -- the disk sector freed
+//----------------------------------------------------------------------
+
+void
+Journal::Revoke(int sectorNumber)
+{
+    lock->Acquire();
+    if (inLog->Test(sectorNumber) || inTransaction->Test(sectorNumber)) {
+	for (int i = numBlocks; i < numEntries; i++)
+	    if (entries[i] == sectorNumber) {
+		lock->Release();
+		return;			// revoked already
+	    }
+	if (numEntries == JournalMaxEntries)
+	    Overflow();			// which empties the log
+	if (inLog->Test(sectorNumber) || inTransaction->Test(sectorNumber))
+	    entries[numEntries++] = sectorNumber;
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::Sync
+// 	Commit the running transaction, and write every sector in the
+//	cache that the log has no copy of home.  When this returns, the
+//	disk -- its home locations and its log together -- is up to date.
+//----------------------------------------------------------------------
+
+void
+Journal::Sync()
+{
+    lock->Acquire();
+    Commit();
+    cache->FlushUnlogged();
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::CommitBehind
+// 	Called from Kernel::PrepareToEnd, when no thread is ready to run,
+//	with interrupts off.  If the disk is idle too, and no operation is
+//	in progress, this is the time to commit the running transaction.
+//	Wake up the committer thread to do it, since we cannot wait here,
+//	and return TRUE if we did.
+//----------------------------------------------------------------------
+
+bool
+Journal::CommitBehind()
+{
+    ASSERT(kernel->interrupt->getLevel() == IntOff);
+    if (commitWanted || committing || numEntries == 0
+		|| !holders->IsEmpty() || synchDisk->IsBusy())
+	return FALSE;
+    commitWanted = TRUE;
+    wakeup->V();
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Journal::Committer
+// 	Wait to be woken up by CommitBehind, and then commit the running
+//	transaction.
+//----------------------------------------------------------------------
+
+void
+Journal::Committer(void *data)
+{
+    Journal *_this = (Journal *) data;
+
+    for (;;) {
+	_this->wakeup->P();
+	_this->lock->Acquire();
+	_this->commitWanted = FALSE;
+	_this->Commit();
+	_this->lock->Release();
+    }
+}
+
+//----------------------------------------------------------------------
+// Journal::Commit
+// 	Write the running transaction to the log, in one disk request, and
+//	start a new one.  Once the log is on disk, the sectors of the
+//	transaction are free to go home, but need not.
+//
+//	Called with the journal lock held.  We wait for the operations in
+//	progress to end, and for any earlier commit to finish; the lock is
+//	released while the log is written, so new operations can start.
+//----------------------------------------------------------------------
+
+void
+Journal::Commit()
+{
+    while (committing || !holders->IsEmpty())
+	changed->Wait(lock);
+    if (numEntries == 0)
+	return;
+
+    int numDescs = divRoundUp(numEntries, JournalDescEntries);
+    int length = numDescs + numBlocks + 1;
+    if (head + length > JournalLogSectors)
+	Checkpoint();			// no room; start the log over
+
+    // lay the transaction out in the image of the log; the contents of
+    // the sectors are copied from their (pinned) buffers in the cache,
+    // which are logged from now on
+    int start = head, slot = 1 + head;
+    for (int e = 0; e < numEntries; ) {
+	JournalDescriptor *desc = (JournalDescriptor *) slots[slot++];
+
+	memset(desc, 0, SectorSize);
+	desc->magic = JournalDescMagic;
+	desc->sequence = sequence;
+	desc->length = length;
+	desc->count = min(JournalDescEntries, numEntries - e);
+	for (int j = 0; j < desc->count; j++, e++) {
+	    if (e < numBlocks) {
+		desc->entries[j] = entries[e];
+		cache->CopyLogged(entries[e], slots[slot++]);
+	    } else
+		desc->entries[j] = -(entries[e] + 1);
+	}
+    }
+    JournalCommit *commit = (JournalCommit *) slots[slot];
+    memset(commit, 0, SectorSize);
+    commit->magic = JournalCommitMagic;
+    commit->sequence = sequence;
+    commit->checksum = Checksum(start, length - 1);
+
+    // the transaction is frozen; hand its sectors over, and start anew
+    int *blocks = new int[numBlocks];
+    int count = numBlocks;
+    for (int i = 0; i < numBlocks; i++) {
+	blocks[i] = entries[i];
+	inTransaction->Clear(entries[i]);
+	inLog->Mark(entries[i]);
+    }
+    numBlocks = numEntries = 0;
+    head += length;
+    sequence++;
+    committing = TRUE;
+
+    DEBUG(dbgFile, "Committing transaction " << sequence - 1 << ", "
+		<< count << " sectors, at " << start << " in the log");
+    lock->Release();
+    synchDisk->WriteSectors(JournalSector + 1 + start, &slots[1 + start],
+								length);
+    lock->Acquire();
+    for (int i = 0; i < count; i++)
+	cache->Unpin(blocks[i]);
+    delete [] blocks;
+    kernel->stats->numJournalCommits++;
+    kernel->stats->numJournalSectors += length;
+    committing = FALSE;
+    changed->Broadcast(lock);
+}
+
+//----------------------------------------------------------------------
+// Journal::Checkpoint
+// 	Write every dirty sector in the cache home, logged or not, except
+//	the ones the running transaction has pinned, and then empty the
+//	log.  The running transaction will be the first in the new log.
+//
+//	Called with the journal lock held.
+//----------------------------------------------------------------------
+
+void
+Journal::Checkpoint()
+{
+    while (committing)
+	changed->Wait(lock);
+    cache->Flush();
+    delete inLog;
+    inLog = new Bitmap(NumSectors);
+    head = 0;
+    WriteHeader();
+    kernel->stats->numJournalCheckpoints++;
+}
+
+//----------------------------------------------------------------------
+// Journal::Overflow
+// 	The running transaction is too large for the log.  Stop logging
+//	it: its sectors may go home as they are, and everything is written
+//	home right away, so nothing in the log depends on it.  The
+//	operations in progress are no longer atomic, as without a journal;
+//	what they write from now on goes into a new transaction.
+//
+//	Called with the journal lock held.
+//----------------------------------------------------------------------
+
+void
+Journal::Overflow()
+{
+    DEBUG(dbgFile, "Transaction too large for the journal");
+    for (int i = 0; i < numBlocks; i++) {
+	cache->Unpin(entries[i]);
+	inTransaction->Clear(entries[i]);
+    }
+    numBlocks = numEntries = 0;
+    Checkpoint();
+}
+
+//----------------------------------------------------------------------
+// Journal::WriteHeader
+// 	Write the journal header, saying the log is empty: the next
+//	transaction will be the running one, at the start of the log.
+//----------------------------------------------------------------------
+
+void
+Journal::WriteHeader()
+{
+    JournalHeader *header = (JournalHeader *) slots[0];
+
+    memset(header, 0, SectorSize);
+    header->magic = JournalMagic;
+    header->size = JournalLogSectors;
+    header->sequence = sequence;
+    synchDisk->WriteSector(JournalSector, slots[0]);
+}
+
+//----------------------------------------------------------------------
+// Journal::Check
+// 	Return TRUE if the log holds a complete transaction, numbered
+//	"sequence", at "start", and set "*length" to its length in sectors.
+//	Its first sector must have been read in already; we read the rest
+//	of it, and the sector after it, in one request.
+//
+//	"start" -- where the transaction would be in the log
+//	"length" -- set to the number of sectors in the transaction
+//----------------------------------------------------------------------
+
+bool
+Journal::Check(int start, int *length)
+{
+    JournalDescriptor *desc = (JournalDescriptor *) slots[1 + start];
+    int n = desc->length;
+
+    if (desc->magic != JournalDescMagic || desc->sequence != sequence
+		|| n < 2 || start + n > JournalLogSectors)
+	return FALSE;
+    synchDisk->ReadSectors(JournalSector + 1 + start + 1, &slots[1 + start + 1],
+				min(n, JournalLogSectors - start - 1));
+
+    JournalCommit *commit = (JournalCommit *) slots[start + n];
+    if (commit->magic != JournalCommitMagic || commit->sequence != sequence
+		|| commit->checksum != Checksum(start, n - 1))
+	return FALSE;
+
+    // the descriptors must account for every sector in between
+    for (int slot = start; slot < start + n - 1; ) {
+	desc = (JournalDescriptor *) slots[1 + slot];
+	if (desc->magic != JournalDescMagic || desc->sequence != sequence
+		|| desc->count <= 0 || desc->count > JournalDescEntries)
+	    return FALSE;
+	slot++;
+	for (int j = 0; j < desc->count; j++)
+	    if (desc->entries[j] >= 0)
+		slot++;
+	if (slot > start + n - 1)
+	    return FALSE;
+    }
+    *length = n;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Journal::Replay
+// 	Load the sectors logged by the transaction at "start" into the
+//	sector cache, except for the ones marked in "done": those were
+//	revoked, or written by a later transaction.  Return the number of
+//	sectors loaded.  Every sector logged is now in the log, revoked
+//	or not, as far as new transactions are concerned.
+//
+//	"start" -- where the transaction is in the log (already read in)
+//	"done" -- sectors not to write; updated
+//----------------------------------------------------------------------
+
+int
+Journal::Replay(int start, Bitmap *done)
+{
+    JournalDescriptor *desc = (JournalDescriptor *) slots[1 + start];
+    int end = start + desc->length - 1;		// the commit sector
+    int count = 0;
+
+    // a revoke covers the sector in this transaction too
+    for (int slot = start; slot < end; ) {
+	desc = (JournalDescriptor *) slots[1 + slot++];
+	for (int j = 0; j < desc->count; j++) {
+	    if (desc->entries[j] < 0)
+		done->Mark(-desc->entries[j] - 1);
+	    else
+		slot++;
+	}
+    }
+    for (int slot = start; slot < end; ) {
+	desc = (JournalDescriptor *) slots[1 + slot++];
+	for (int j = 0; j < desc->count; j++) {
+	    int sector = desc->entries[j];
+
+	    if (sector < 0)
+		continue;
+	    inLog->Mark(sector);
+	    if (!done->Test(sector)) {
+		cache->WriteLogged(sector, slots[1 + slot]);
+		done->Mark(sector);
+		count++;
+	    }
+	    slot++;
+	}
+    }
+    return count;
+}
+
+//----------------------------------------------------------------------
+// Journal::Checksum
+// 	Return a checksum of "count" sectors of the log, starting at
+//	"start", as laid out in the image.
+//----------------------------------------------------------------------
+
+unsigned int
+Journal::Checksum(int start, int count)
+{
+    unsigned int *word = (unsigned int *) slots[1 + start];
+    unsigned int sum = 0;
+
+    for (int i = 0; i < count * SectorSize / (int) sizeof(unsigned int); i++)
+	sum = ((sum << 1) | (sum >> 31)) + word[i];
+    return sum;
+}
@@ -0,0 +1,169 @@
+// journal.h
+//	Data structures for the metadata journal -- a write-ahead log that
+//	makes each file system operation (Create, Remove) atomic with
+//	respect to crashes.
+//
+//	An operation brackets its updates with Begin and End.  Every sector
+//	written through the journal in between (file headers, index sectors,
+//	directory blocks, sectors of the free map) is "logged": its buffer
+//	in the sector cache is pinned, so that it cannot reach its home
+//	location on disk before the operation is safely in the log.
+//
+//	Operations are grouped into transactions.  A transaction is
+//	committed -- copied to the log in one sequential disk request --
+//	when it has grown large, when the machine goes idle, or when asked
+//	to (Sync).  After that its buffers are "logged": they go home when
+//	the sector cache replaces them, but nothing else hurries them, since
+//	the log has them already.  Only when the log fills up is everything
+//	written home and the log emptied (a "checkpoint"), by rewriting the
+//	journal header.
+//
+//	When the disk is mounted, transactions found complete in the log
+//	are replayed: their sectors are loaded into the sector cache, as
+//	logged buffers, and the log carries on from where it ended.
+//
+//	A sector that is in the log is logged whenever it is written, even
+//	outside an operation, so that the log never holds a copy older than
+//	the one at home.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "disk.h"
+#include "synch.h"
+#include "list.h"
+#include "bitmap.h"
+
+class SectorCache;
+class SynchDisk;
+
+#define JournalSector		3	// journal header, after the superblock;
+					// the log follows it
+#define JournalLogSectors	1024	// sectors in the log
+#define JournalBatch		64	// sectors logged before a transaction
+					// is committed by the next Begin
+#define JournalMaxEntries	512	// most sectors (and revoked sectors)
+					// one transaction can hold
+
+// The log is a sequence of transactions, starting at the first sector
+// after the journal header.  Each transaction is one or more descriptor
+// sectors, each followed by the contents of the sectors it lists, and
+// then a commit sector.  A transaction counts only if its commit sector
+// is there, with the right sequence number and checksum.
+//
+// A descriptor entry of -(sector + 1) "revokes" a sector: the sector was
+// freed, so copies of it earlier in the log must not be replayed over
+// whatever it is used for next.
+
+#define JournalMagic		0x4a4c0001	// "JL", format 1
+#define JournalDescMagic	0x4a4c4453	// "JLDS"
+#define JournalCommitMagic	0x4a4c434d	// "JLCM"
+#define JournalDescEntries	((int) (SectorSize / sizeof(int)) - 4)
+
+class JournalHeader {
+  public:
+    int magic;				// JournalMagic
+    int size;				// Sectors in the log
+    int sequence;			// Sequence number of the transaction
+					// expected at the start of the log
+    int unused[(SectorSize / sizeof(int)) - 3];	// pad to a sector
+};
+
+class JournalDescriptor {
+  public:
+    int magic;				// JournalDescMagic
+    int sequence;			// Transaction this is part of
+    int length;				// Sectors in the whole transaction,
+					//   commit sector included
+    int count;				// Entries used
+    int entries[JournalDescEntries];	// Sectors logged (or revoked)
+};
+
+class JournalCommit {
+  public:
+    int magic;				// JournalCommitMagic
+    int sequence;			// Transaction committed
+    unsigned int checksum;		// Of the transaction's other sectors
+    int unused[(SectorSize / sizeof(int)) - 3];	// pad to a sector
+};
+
+// The following class defines the journal.  There is one, kernel-wide,
+// on top of the sector cache; the log itself is read and written
+// directly on the disk, bypassing the cache.
+
+class Journal {
+  public:
+    Journal(SectorCache *cache, SynchDisk *disk);
+					// Initialize the journal, and start
+					// the thread that commits at idle
+    ~Journal();				// De-allocate the journal
+
+    void Format();			// Write an empty log on a new disk
+    void Recover();			// Replay the transactions committed
+					// in the log, when mounting the disk
+
+    void Begin();			// Start an operation on the file
+					// system's metadata
+    void End();				// The operation is complete
+    bool InOperation();			// Is the current thread inside an
+					// operation?
+    void WriteSector(int sectorNumber, char* data);
+					// Write a sector through the sector
+					// cache, logging it if the current
+					// thread is inside an operation
+    void Revoke(int sectorNumber);	// A sector has been freed
+
+    void Sync();			// Commit the current transaction,
+					// and write everything else home
+    bool CommitBehind();		// Have the committer thread commit,
+					// if there is something to commit.
+					// Called with interrupts off, when
+					// no thread is ready to run.
+
+  private:
+    SectorCache *cache;			// Where sectors are logged from
+    SynchDisk *synchDisk;		// Where the log is written
+    Lock *lock;				// Mutual exclusion on the journal
+    Condition *changed;			// Signalled when an operation ends
+					// or a commit finishes
+    List<Thread *> *holders;		// Threads inside an operation, once
+					// per Begin
+    int *entries;			// Sectors logged by the running
+    int numBlocks;			// transaction, then the sectors it
+    int numEntries;			// revoked: entries[numBlocks..]
+    Bitmap *inTransaction;		// Sectors in the running transaction
+    Bitmap *inLog;			// Sectors in the log since it was
+					// last emptied
+    int sequence;			// Number of the running transaction
+    int head;				// First free sector of the log
+    bool committing;			// Is a commit being written?
+    bool commitWanted;			// Has the committer been woken?
+    Semaphore *wakeup;			// Wakes up the committer
+    char *image;			// The journal header and the log,
+					// as on disk, one sector per slot
+    char **slots;			// Each slot of "image"
+
+    static void Committer(void *data);	// Commit at idle, forever
+
+    void Commit();			// Write the running transaction to
+					// the log, and wait for it
+    void Checkpoint();			// Write everything home, and empty
+					// the log
+    void Overflow();			// Give up logging a transaction
+					// that has grown too large
+    void WriteHeader();			// Record that the log is empty
+    bool Check(int start, int *length);	// Is there a complete transaction
+					// at "start" in the log?
+    int Replay(int start, Bitmap *done);
+					// Load a transaction into the cache
+    unsigned int Checksum(int start, int count);
+					// Of "count" sectors of the log
+};
+
+#endif // JOURNAL_H
@@ -5,7 +5,36 @@
 //	the OpenFile data structure).
 //
 //	Also as in UNIX, for convenience, we keep the file header in
-//	memory while the file is open.
+//	memory while the file is open.  The header comes from the kernel's
+//	in-core inode table, so all OpenFiles of a file share one copy.
+//
+//	Each OpenFile watches whether it is being read sequentially.  If
+//	so, it has the sector cache read the sectors after the ones asked
+//	for ahead of time, in a window that doubles (up to ReadAheadMax)
+//	every time the reader catches up with half of it.  A read that
+//	does not carry on from the previous one starts over.
+//
+//	Files grow as they are written.  A write past the end of the file,
+//	or into a hole, first has the file system allocate the sectors it
+//	needs, all at once (FileSystem::Fill); holes read as zeroes.
+//
+//	Small writes are not written to the file's sectors right away, but
+//	collected in a write-behind buffer, kept with the in-core inode so
+//	that every OpenFile of the file sees them.  As long as each write
+//	carries on from (or lands within) the data already waiting, it is
+//	just copied into the buffer.  The buffer is written out when the
+//	next write does not fit, when the file is read where the buffer
+//	is, when the file is closed or flushed, or when another file needs
+//	the buffer.  So a file written a few bytes at a time is written a
+//	buffer at a time, and its sectors are allocated then, in one run
+//	for the whole buffer.  Writes made inside a journal operation (to
+//	directories and the free map) are never held back, nor are any
+//	writes once the disk is nearly full, so that what is buffered can
+//	be given space when it is written out.  Should that still fail,
+//	the next Flush (on Fsync or Close) reports it.
+//
+//	A small file may be kept in its header (see filehdr.h); it is then
+//	read and written in the in-core header, with no sector of its own.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -16,21 +45,47 @@
 #include "main.h"
 #include "filehdr.h"
 #include "openfile.h"
-#include "synchdisk.h"
+#include "inodetable.h"
+#include "sectorcache.h"
+#include "journal.h"
+#include "flusher.h"
 
 //----------------------------------------------------------------------
 // OpenFile::OpenFile
 // 	Open a Nachos file for reading and writing.  Bring the file header
-//	into memory while the file is open.
+//	into memory while the file is open (unless it is already there).
 //
 //	"sector" -- the location on disk of the file header for this file
 //----------------------------------------------------------------------
 
 OpenFile::OpenFile(int sector)
 { 
-    hdr = new FileHeader;
-    hdr->FetchFrom(sector);
+    inode = kernel->inodeTable->Open(sector);
+    hdr = inode->hdr;
+    seekPosition = 0;
+    nextPosition = -1;
+    aheadWindow = 0;
+    aheadEnd = 0;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::OpenFile
+// 	Open a Nachos file through its in-core inode, to which the caller
+//	has already added a reference (that the OpenFile now owns).  Used
+//	by the inode table to write out a buffer without looking the file
+//	up again by its sector, which may since have been freed.
+//
+//	"inode" -- the in-core inode of the file
+//----------------------------------------------------------------------
+
+OpenFile::OpenFile(Inode *inode)
+{ 
+    this->inode = inode;
+    hdr = inode->hdr;
     seekPosition = 0;
+    nextPosition = -1;
+    aheadWindow = 0;
+    aheadEnd = 0;
 }
 
 //----------------------------------------------------------------------
@@ -40,7 +95,8 @@ OpenFile::OpenFile(int sector)
 
 OpenFile::~OpenFile()
 {
-    delete hdr;
+    FlushBuffer();
+    kernel->inodeTable->Close(inode);
 }
 
 //----------------------------------------------------------------------
@@ -97,13 +153,35 @@ OpenFile::Write(char *into, int numBytes)
 //	sector at a time.  Thus:
 //
 //	For ReadAt:
-//	   We read in all of the full or partial sectors that are part of the
-//	   request, but we only copy the part we are interested in.
+//	   Sectors that are wholly part of the request are read straight
+//	   into the caller's buffer, a run of sectors that are consecutive
+//	   on disk at a time.  A sector that is only partly wanted (at
+//	   either end of the request) is read into a sector-sized staging
+//	   buffer, and we only copy the part we are interested in.  Holes
+//	   are not read at all, but zeroed.
 //	For WriteAt:
-//	   We must first read in any sectors that will be partially written,
-//	   so that we don't overwrite the unmodified portion.  We then copy
-//	   in the data that will be modified, and write back all the full
-//	   or partial sectors that are part of the request.
+//	   A write smaller than the write-behind buffer goes there (see
+//	   WriteBehind).  Other writes, and the contents of the buffer when
+//	   it is flushed, are written by WriteThrough, as follows.
+//	   Sectors that are wholly overwritten are written straight from
+//	   the caller's buffer.  A sector that is only partly written must
+//	   first be read into the staging buffer, so that we don't overwrite
+//	   the unmodified portion; we then copy in the data that will be
+//	   modified, and write the sector back.  If the sector was a hole,
+//	   or the part not written is past the end of the file, that part
+//	   is zeroed instead.  A write may start past the end of the file,
+//	   leaving a hole, and makes the file longer if it ends past it.
+//
+//	A file kept in its header is read out of the in-core header, and
+//	written there for as long as it still fits (then the header is
+//	written back).
+//
+//	A file that has been removed, but is still open, cannot be written:
+//	its header and data sectors are free already, and may belong to
+//	another file by now.
+//
+//	The staging buffer is on the stack, so the data path makes no heap
+//	allocations.
 //
 //	"into" -- the buffer to contain the data to be read from disk 
 //	"from" -- the buffer containing the data to be written to disk 
@@ -116,98 +194,363 @@ int
 OpenFile::ReadAt(char *into, int numBytes, int position)
 {
     int fileLength = hdr->FileLength();
-	FileHeader *recurHdr = hdr;
-	// for(recurHdr = hdr; recurHdr->getNextHeader() != NULL; recurHdr = recurHdr->getNextHeader()) fileLength += recurHdr->FileLength();    
-    while(recurHdr->getNextHeader() != NULL){
-        recurHdr = recurHdr->getNextHeader();
-        fileLength += recurHdr->FileLength();
-    }
-
-	int i, firstSector, lastSector, numSectors;
-    char *buf;
+    int i, firstSector, lastSector, end, run;
+    char staging[SectorSize];		// for partly wanted sectors
 	
+    if (inode->pendingBytes > 0 && position + numBytes > inode->pendingStart) {
+	FlushBuffer();				// the data is in the buffer
+	fileLength = hdr->FileLength();
+    }
     if ((numBytes <= 0) || (position >= fileLength))
     	return 0; 				// check request
     if ((position + numBytes) > fileLength)		
 	numBytes = fileLength - position;
     DEBUG(dbgFile, "Reading " << numBytes << " bytes at " << position << " from file of length " << fileLength);
 
+    if (hdr->IsInline()) {
+	hdr->ReadInline(into, position, numBytes);
+	return numBytes;
+    }
+
     firstSector = divRoundDown(position, SectorSize);
     lastSector = divRoundDown(position + numBytes - 1, SectorSize);
-    numSectors = 1 + lastSector - firstSector;
+    end = position + numBytes;
 
-    // read in all the full and partial sectors that we need
-    buf = new char[numSectors * SectorSize];
-    for (i = firstSector; i <= lastSector; i++)	
-        kernel->synchDisk->ReadSector(hdr->ByteToSector(i * SectorSize), 
-					&buf[(i - firstSector) * SectorSize]);
+    for (i = firstSector; i <= lastSector; i += run) {
+	int sector = hdr->ByteToSector(i * SectorSize);
+	int start = max(position, i * SectorSize);
+	int stop = min(end, (i + 1) * SectorSize);
 
-    // copy the part we want
-    bcopy(&buf[position - (firstSector * SectorSize)], into, numBytes);
-    delete [] buf;
+	run = 1;
+	if (sector == -1) {			// a hole
+	    memset(&into[start - position], 0, stop - start);
+	    continue;
+	}
+	if (stop - start < SectorSize) {	// partial sector
+	    kernel->sectorCache->ReadSector(sector, staging);
+	    bcopy(&staging[start - i * SectorSize], &into[start - position],
+							stop - start);
+	    continue;
+	}
+	while (i + run <= lastSector && (i + run + 1) * SectorSize <= end
+		&& hdr->ByteToSector((i + run) * SectorSize) == sector + run)
+	    run++;
+        kernel->sectorCache->ReadSectors(sector, &into[start - position], run);
+    }
+
+    // watch for sequential reading
+    if (position == nextPosition)
+	ReadAhead(lastSector);
+    else
+	aheadWindow = aheadEnd = 0;
+    nextPosition = end;
     return numBytes;
 }
 
 int
 OpenFile::WriteAt(char *from, int numBytes, int position)
 {
-    int fileLength = hdr->FileLength();
-    FileHeader *recurHdr = hdr;
-    // for(recurHdr = hdr; recurHdr->getNextHeader() != NULL; recurHdr = recurHdr->getNextHeader()) fileLength += recurHdr->FileLength();    
-    while(recurHdr->getNextHeader() != NULL){
-        recurHdr = recurHdr->getNextHeader();
-        fileLength += recurHdr->FileLength();
+    if ((numBytes <= 0) || (position < 0) || (position >= (int)MaxFileSize)
+		|| inode->removed)
+	return 0;				// check request
+    if (numBytes > (int)MaxFileSize - position)
+	numBytes = MaxFileSize - position;
+
+    if (numBytes < WriteBehindSize && !kernel->journal->InOperation()
+		&& (kernel->fileSystem == NULL		// still formatting
+		    || kernel->fileSystem->NumFree() > WriteBehindReserve))
+	return WriteBehind(from, numBytes, position);
+    FlushBuffer();			// keep the writes in order
+    return WriteThrough(from, numBytes, position);
+}
+
+//----------------------------------------------------------------------
+// OpenFile::WriteBehind
+// 	Put a write in the file's write-behind buffer, getting a buffer
+//	first if the file has none.  If the buffer holds data the write
+//	does not carry on from, or does not have room for the write, what
+//	it holds is flushed first -- only the whole sectors at its start,
+//	if the write carries on from the end of the data, so that the
+//	buffer keeps taking the file a sector at a time.
+//
+//	"from" -- the data to be written
+//	"numBytes" -- the number of bytes, less than WriteBehindSize
+//	"position" -- where in the file to write them
+//----------------------------------------------------------------------
+
+int
+OpenFile::WriteBehind(char *from, int numBytes, int position)
+{
+    int start, end;
+
+    inode->bufferLock->Acquire();
+    start = inode->pendingStart;
+    end = start + inode->pendingBytes;
+    if (inode->pendingBytes > 0 && position == end
+		&& position + numBytes > start + WriteBehindSize)
+	FlushSectors(FALSE);
+    start = inode->pendingStart;
+    if (inode->pendingBytes > 0 && (position < start
+		|| position > start + inode->pendingBytes
+		|| position + numBytes > start + WriteBehindSize))
+	FlushSectors(TRUE);
+
+    if (inode->pending == NULL)
+	kernel->inodeTable->GetBuffer(inode);
+    if (inode->pendingBytes == 0) {
+	inode->pendingStart = position;
+	inode->pendingSince = kernel->stats->totalTicks;
     }
+    DEBUG(dbgFile, "Buffering " << numBytes << " bytes at " << position);
+    bcopy(from, &inode->pending[position - inode->pendingStart], numBytes);
+    inode->pendingBytes = max(inode->pendingBytes,
+				position + numBytes - inode->pendingStart);
+    kernel->stats->numWritesBuffered++;
+    kernel->flusher->Dirtied();
+    inode->bufferLock->Release();
+    return numBytes;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::Flush
+// 	Write out whatever is waiting in the file's write-behind buffer.
+//	Return FALSE if some data written to the file, through any of its
+//	OpenFiles, was lost since the last Flush because the disk had no
+//	room for it when the buffer was written out.
+//----------------------------------------------------------------------
 
-    int i, firstSector, lastSector, numSectors;
-    bool firstAligned, lastAligned;
-    char *buf;
+bool
+OpenFile::Flush()
+{
+    bool lost;
 
-    if ((numBytes <= 0) || (position >= fileLength))
-	return 0;				// check request
-    if ((position + numBytes) > fileLength)
-	numBytes = fileLength - position;
+    inode->bufferLock->Acquire();
+    FlushSectors(TRUE);
+    lost = inode->writeError;
+    inode->writeError = FALSE;		// reported now
+    inode->bufferLock->Release();
+    return !lost;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::FlushBuffer
+// 	Write out the write-behind buffer, as Flush does, when there is
+//	nobody to tell if that fails: the error is kept for the next Flush.
+//----------------------------------------------------------------------
+
+void
+OpenFile::FlushBuffer()
+{
+    inode->bufferLock->Acquire();
+    FlushSectors(TRUE);
+    inode->bufferLock->Release();
+}
+
+//----------------------------------------------------------------------
+// OpenFile::FlushSectors
+// 	Write out the data waiting in the write-behind buffer: all of it,
+//	or, unless "all", only up to the last sector boundary it covers,
+//	keeping the rest (part of a sector) at the start of the buffer.
+//
+//	Writing the buffer is where its sectors get allocated.  If the
+//	disk is full, the data is lost; the writes that put it there have
+//	long since returned, so the inode remembers it for Flush to report.
+//
+//	The caller holds the inode's buffer lock.
+//----------------------------------------------------------------------
+
+void
+OpenFile::FlushSectors(bool all)
+{
+    int count = inode->pendingBytes;
+
+    if (!all)
+	count = divRoundDown(inode->pendingStart + count, SectorSize)
+			* SectorSize - inode->pendingStart;
+    if (count <= 0)
+	return;
+    if (!inode->removed) {
+	kernel->stats->numWriteFlushes++;
+	if (WriteThrough(inode->pending, count, inode->pendingStart) == 0) {
+	    DEBUG(dbgFile, "Disk full: lost " << count << " bytes at "
+					<< inode->pendingStart);
+	    inode->writeError = TRUE;
+	}
+    }
+    inode->pendingBytes -= count;
+    inode->pendingStart += count;
+    bcopy(&inode->pending[count], inode->pending, inode->pendingBytes);
+}
+
+//----------------------------------------------------------------------
+// OpenFile::WriteThrough
+// 	Write to the file's sectors (through the sector cache), as
+//	described above for WriteAt.  Return the number of bytes written;
+//	0 if the disk is too full, or the file has been removed (perhaps
+//	while we waited for the buffer lock).
+//----------------------------------------------------------------------
+
+int
+OpenFile::WriteThrough(char *from, int numBytes, int position)
+{
+    int fileLength = hdr->FileLength();
+    int i, firstSector, lastSector, end;
+    bool firstHole, lastHole;
+    char staging[SectorSize];		// for partly written sectors
+
+    if (inode->removed)
+	return 0;				// its sectors are not ours
     DEBUG(dbgFile, "Writing " << numBytes << " bytes at " << position << " from file of length " << fileLength);
 
     firstSector = divRoundDown(position, SectorSize);
     lastSector = divRoundDown(position + numBytes - 1, SectorSize);
-    numSectors = 1 + lastSector - firstSector;
+    end = position + numBytes;
 
-    buf = new char[numSectors * SectorSize];
-	
-	// Mp4 mod tag
-	memset(buf, 0, sizeof(char) * numSectors * SectorSize); // dummy operation to keep valgrind happy
-
-    firstAligned = (position == (firstSector * SectorSize));
-    lastAligned = ((position + numBytes) == ((lastSector + 1) * SectorSize));
-
-// read in first and last sector, if they are to be partially modified
-    if (!firstAligned)
-        ReadAt(buf, SectorSize, firstSector * SectorSize);	
-    if (!lastAligned && ((firstSector != lastSector) || firstAligned))
-        ReadAt(&buf[(lastSector - firstSector) * SectorSize], 
-				SectorSize, lastSector * SectorSize);	
-
-// copy in the bytes we want to change 
-    bcopy(from, &buf[position - (firstSector * SectorSize)], numBytes);
-
-// write modified sectors back
-    for (i = firstSector; i <= lastSector; i++)	
-        kernel->synchDisk->WriteSector(hdr->ByteToSector(i * SectorSize), 
-					&buf[(i - firstSector) * SectorSize]);
-    delete [] buf;
+    if (hdr->IsInline()) {
+	if (end <= InlineSize) {		// still fits in the header
+	    hdr->WriteInline(from, position, numBytes);
+	    hdr->WriteBack(inode->sector);
+	    return numBytes;
+	}
+	// move what the header holds to a data sector first, so that
+	// its sector is not taken for a hole below
+	if (fileLength > 0
+		&& !kernel->fileSystem->Fill(this, 0, fileLength))
+	    return 0;				// disk full
+    }
+
+    // make room for the data, remembering which partly written sectors
+    // are new, and have nothing worth reading
+    firstHole = hdr->ByteToSector(firstSector * SectorSize) == -1;
+    lastHole = hdr->ByteToSector(lastSector * SectorSize) == -1;
+    if (!hdr->IsAllocated(position, numBytes)
+		&& !kernel->fileSystem->Fill(this, position, numBytes))
+	return 0;				// disk full
+
+    for (i = firstSector; i <= lastSector; i++) {
+	int sector = hdr->ByteToSector(i * SectorSize);
+	int start = max(position, i * SectorSize);
+	int stop = min(end, (i + 1) * SectorSize);
+
+	if (stop - start < SectorSize) {	// partial sector
+	    if ((i == firstSector && firstHole)
+			|| (i == lastSector && lastHole))
+		memset(staging, 0, SectorSize);
+	    else {
+		kernel->sectorCache->ReadSector(sector, staging);
+		if (fileLength < (i + 1) * SectorSize)	// clear past the end
+		    memset(&staging[max(fileLength - i * SectorSize, 0)], 0,
+			    SectorSize - max(fileLength - i * SectorSize, 0));
+	    }
+	    bcopy(&from[start - position], &staging[start - i * SectorSize],
+							stop - start);
+	    kernel->journal->WriteSector(sector, staging);
+	} else
+	    kernel->journal->WriteSector(sector, &from[start - position]);
+    }
     return numBytes;
 }
 
+//----------------------------------------------------------------------
+// OpenFile::ReadAhead
+// 	Called after a read that carried on where the previous one left
+//	off.  If fewer than half a window of sectors past the read are
+//	already read ahead (or on their way), ask the sector cache to read
+//	the next window, and make the window after that twice as large.
+//
+//	"lastSector" -- the last sector of the file that was read
+//----------------------------------------------------------------------
+
+void
+OpenFile::ReadAhead(int lastSector)
+{
+    int fileSectors = divRoundUp(hdr->FileLength(), SectorSize);
+    int first, last, run;
+
+    if (aheadWindow == 0)
+	aheadWindow = ReadAheadMin;
+    if (aheadEnd - (lastSector + 1) > aheadWindow / 2)
+	return;				// still well ahead
+
+    first = max(aheadEnd, lastSector + 1);
+    last = min(first + aheadWindow, fileSectors) - 1;
+    aheadEnd = last + 1;
+    aheadWindow = min(2 * aheadWindow, ReadAheadMax);
+
+    // a run of sectors that are consecutive on disk at a time
+    for (int i = first; i <= last; i += run) {
+	int sector = hdr->ByteToSector(i * SectorSize);
+
+	run = 1;
+	if (sector == -1)
+	    continue;				// nothing to read in a hole
+	while (i + run <= last
+		&& hdr->ByteToSector((i + run) * SectorSize) == sector + run)
+	    run++;
+	kernel->sectorCache->ReadAhead(sector, run);
+    }
+}
+
 //----------------------------------------------------------------------
 // OpenFile::Length
-// 	Return the number of bytes in the file.
+// 	Return the number of bytes in the file, counting any data still
+//	in the write-behind buffer.
 //----------------------------------------------------------------------
 
 int
 OpenFile::Length() 
 { 
+    if (inode->pendingBytes > 0)	// may reach past the end
+	return max(hdr->FileLength(),
+			inode->pendingStart + inode->pendingBytes);
     return hdr->FileLength(); 
 }
 
+//----------------------------------------------------------------------
+// OpenFile::Extend
+// 	Grow the file to "newLength" bytes, allocating space for the new
+//	data out of "freeMap".  The header is written back right away, so
+//	the caller only has to write back the free map.  Return FALSE if
+//	the disk is too full.
+//
+//	"newLength" -- the new length of the file
+//	"freeMap" -- the bit map of free disk sectors
+//----------------------------------------------------------------------
+
+bool
+OpenFile::Extend(int newLength, PersistentBitmap *freeMap)
+{
+    if (newLength <= hdr->FileLength())
+	return TRUE;
+    if (!hdr->Extend(freeMap, newLength, inode->sector))
+	return FALSE;
+    hdr->WriteBack(inode->sector);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::Fill
+// 	Allocate data sectors, out of "freeMap", for the holes in a range
+//	of the file that is about to be written, and make the file long
+//	enough to hold the range.  As for Extend, the header is written
+//	back right away.  Return FALSE if the disk is too full, or if the
+//	file was removed while the caller waited to start its journal
+//	operation (its header sector is free then).
+//
+//	"position" -- where the range starts in the file
+//	"numBytes" -- the length of the range
+//	"freeMap" -- the bit map of free disk sectors
+//----------------------------------------------------------------------
+
+bool
+OpenFile::Fill(int position, int numBytes, PersistentBitmap *freeMap)
+{
+    if (inode->removed)
+	return FALSE;
+    if (!hdr->Fill(freeMap, position, numBytes, inode->sector))
+	return FALSE;
+    hdr->WriteBack(inode->sector);
+    return TRUE;
+}
+
 #endif //FILESYS_STUB
@@ -60,12 +60,21 @@ class OpenFile {
 };
 
 #else // FILESYS
+#define ReadAheadMin		8	// sectors read ahead when sequential
+					// reading is first noticed
+#define ReadAheadMax		64	// most sectors read ahead at a time
+
 class FileHeader;
+class Inode;
+class PersistentBitmap;
 
 class OpenFile {
   public:
     OpenFile(int sector);		// Open a file whose header is located
 					// at "sector" on the disk
+    OpenFile(Inode *inode);		// Open a file through its in-core
+					// inode, taking over a reference
+					// the caller already holds
     ~OpenFile();			// Close the file
 
     void Seek(int position); 		// Set the position from which to 
@@ -82,14 +91,44 @@ class OpenFile {
 					// bypassing the implicit position.
     int WriteAt(char *from, int numBytes, int position);
 
+    bool Flush();			// Write out the file's write-behind
+					// buffer; FALSE if buffered data
+					// could not be written
+
     int Length(); 			// Return the number of bytes in the
 					// file (this interface is simpler 
 					// than the UNIX idiom -- lseek to 
 					// end of file, tell, lseek back 
+
+    bool Extend(int newLength, PersistentBitmap *freeMap);
+					// Grow the file to "newLength" bytes
+    bool Fill(int position, int numBytes, PersistentBitmap *freeMap);
+					// Allocate the holes in a range of
+					// the file, and grow it to cover it
     
   private:
-    FileHeader *hdr;			// Header for this file 
+    Inode *inode;			// In-core inode, shared with every
+					// other OpenFile of this file
+    FileHeader *hdr;			// Header for this file (inode->hdr)
     int seekPosition;			// Current position within the file
+    int nextPosition;			// Where the next read starts, if
+					// the file is read sequentially
+    int aheadWindow;			// Sectors to read ahead next time;
+					// 0 if reads are not sequential
+    int aheadEnd;			// File sector after the last one
+					// read ahead
+
+    void ReadAhead(int lastSector);	// Read ahead of a read that ended
+					// in "lastSector", if sequential
+    int WriteBehind(char *from, int numBytes, int position);
+					// Put a write in the write-behind
+					// buffer
+    void FlushBuffer();			// Write out the buffer, leaving any
+					// error for Flush to report
+    void FlushSectors(bool all);	// Write out the buffer, or only the
+					// whole sectors at its start
+    int WriteThrough(char *from, int numBytes, int position);
+					// Write to the file's sectors
 };
 
 #endif // FILESYS
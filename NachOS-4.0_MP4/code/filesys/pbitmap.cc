@@ -8,6 +8,19 @@
 
 #include "copyright.h"
 #include "pbitmap.h"
+#include "disk.h"
+#include "journal.h"
+#include "main.h"
+
+// Number of bits stored in one sector of the bitmap file
+static const int BitsInSector = SectorSize * BitsInByte;
+
+// The allocation group a bit is in
+static inline int
+GroupOf(int which)
+{
+    return which / SectorsPerGroup;
+}
 
 //----------------------------------------------------------------------
 // PersistentBitmap::PersistentBitmap(int)
@@ -16,31 +29,49 @@
 //
 //	"numItems" is the number of bits in the bitmap.
 //
-//      This constructor does not initialize the bitmap from a disk file
+//      This constructor does not initialize the bitmap from a disk file:
+//	none of the file has been written yet, and the first WriteBack
+//	only writes it up to the last bit set.
 //----------------------------------------------------------------------
 
 PersistentBitmap::PersistentBitmap(int numItems):Bitmap(numItems) 
 { 
+    numMapSectors = divRoundUp(numWords * sizeof(BitWord), SectorSize);
+    dirty = new bool[numMapSectors];
+    for (int i = 0; i < numMapSectors; i++)
+	dirty[i] = FALSE;
+    numWritten = 0;
+    numGroups = divRoundUp(numBits, SectorsPerGroup);
+    groupFree = new int[numGroups];
+    CountGroups();
 }
 
 //----------------------------------------------------------------------
-// PersistentBitmap::PersistentBitmap(OpenFile*,int)
+// PersistentBitmap::PersistentBitmap(OpenFile*,int,int)
 // 	Initialize a persistent bitmap with "numItems" bits,
 //      so that every bit is clear.
 //
 //	"numItems" is the number of bits in the bitmap.
 //      "file" refers to an open file containing the bitmap (written
 //        by a previous call to PersistentBitmap::WriteBack
+//	"numWritten" is the number of sectors of the file written so far
 //
 //      This constructor initializes the bitmap from a disk file
 //----------------------------------------------------------------------
 
-PersistentBitmap::PersistentBitmap(OpenFile *file, int numItems):Bitmap(numItems) 
+PersistentBitmap::PersistentBitmap(OpenFile *file, int numItems,
+					int numWritten):Bitmap(numItems) 
 { 
+    numMapSectors = divRoundUp(numWords * sizeof(BitWord), SectorSize);
+    dirty = new bool[numMapSectors];
+    this->numWritten = numWritten;
+    numGroups = divRoundUp(numBits, SectorsPerGroup);
+    groupFree = new int[numGroups];
+
     // map has already been initialized by the BitMap constructor,
     // but we will just overwrite that with the contents of the
     // map found in the file
-    file->ReadAt((char *)map, numWords * sizeof(unsigned), 0);
+    FetchFrom(file);
 }
 
 //----------------------------------------------------------------------
@@ -50,11 +81,73 @@ PersistentBitmap::PersistentBitmap(OpenFile *file, int numItems):Bitmap(numItems
 
 PersistentBitmap::~PersistentBitmap()
 { 
+    delete [] dirty;
+    delete [] groupFree;
+}
+
+//----------------------------------------------------------------------
+// PersistentBitmap::Mark/Clear
+// 	Set or clear the "nth" bit, and note that the sector of the
+//	bitmap file holding it must be written back, and that its group
+//	has one less (or one more) clear bit.
+//
+//	Clearing a bit frees the sector; the journal must not replay an
+//	old copy of it over whatever the sector is used for next.
+//
+//	"which" is the number of the bit
+//----------------------------------------------------------------------
+
+void
+PersistentBitmap::Mark(int which)
+{
+    if (!Test(which))
+	groupFree[GroupOf(which)]--;
+    Bitmap::Mark(which);
+    dirty[which / BitsInSector] = TRUE;
+}
+
+void
+PersistentBitmap::Clear(int which)
+{
+    if (Test(which))
+	groupFree[GroupOf(which)]++;
+    Bitmap::Clear(which);
+    dirty[which / BitsInSector] = TRUE;
+    kernel->journal->Revoke(which);
+}
+
+//----------------------------------------------------------------------
+// PersistentBitmap::AllocateHeader
+// 	Find a clear bit for the header of a new file, set it, and return
+//	its number, or -1 if no bits are clear.
+//
+//	A file's header goes right after its directory's header, or as
+//	close after it as there is room, so that the directory, the
+//	headers of its files and (since a file's data is allocated after
+//	its header) their data share a group, and looking up and reading
+//	the files of one directory seeks little.  A new directory instead
+//	starts in the group with the most clear bits, so directories
+//	spread out over the disk, and each has room to grow near itself.
+//
+//	"parent" -- the sector of the header of the file's directory
+//	"isDirectory" -- is the new file a directory?
+//----------------------------------------------------------------------
+
+int
+PersistentBitmap::AllocateHeader(int parent, bool isDirectory)
+{
+    int hint = parent, length;
+
+    if (isDirectory)
+	hint = EmptiestGroup(GroupOf(parent)) * SectorsPerGroup;
+    return FindAndSetRun(1, hint, &length);
 }
 
 //----------------------------------------------------------------------
 // PersistentBitmap::FetchFrom
 // 	Initialize the contents of a persistent bitmap from a Nachos file.
+//	Only the sectors of it that were ever written are read; the bits
+//	past them are clear.
 //
 //	"file" is the place to read the bitmap from
 //----------------------------------------------------------------------
@@ -62,12 +155,24 @@ PersistentBitmap::~PersistentBitmap()
 void
 PersistentBitmap::FetchFrom(OpenFile *file) 
 {
-    file->ReadAt((char *)map, numWords * sizeof(unsigned), 0);
+    int mapBytes = numWords * sizeof(BitWord);
+    int written = min(numWritten * SectorSize, mapBytes);
+
+    file->ReadAt((char *)map, written, 0);
+    memset((char *)map + written, 0, mapBytes - written);
+    Rebuild();
+    CountGroups();
+    for (int i = 0; i < numMapSectors; i++)
+	dirty[i] = FALSE;
 }
 
 //----------------------------------------------------------------------
 // PersistentBitmap::WriteBack
 // 	Store the contents of a persistent bitmap to a Nachos file.
+//	Only the sectors that changed since the bitmap was last fetched
+//	or written back are written -- and the sectors before them that
+//	were never written, so that the sectors written so far are still
+//	the first ones of the file.
 //
 //	"file" is the place to write the bitmap to
 //----------------------------------------------------------------------
@@ -75,5 +180,58 @@ PersistentBitmap::FetchFrom(OpenFile *file)
 void
 PersistentBitmap::WriteBack(OpenFile *file)
 {
-   file->WriteAt((char *)map, numWords * sizeof(unsigned), 0);
+    int mapBytes = numWords * sizeof(BitWord);
+    int last = numMapSectors - 1;
+
+    while (last >= numWritten && !dirty[last])
+	last--;
+    for (; numWritten <= last; numWritten++)
+	dirty[numWritten] = TRUE;	// written for the first time
+    for (int i = 0; i < numMapSectors; i++) {
+	if (!dirty[i])
+	    continue;
+	int offset = i * SectorSize;
+	file->WriteAt((char *)map + offset, min(SectorSize, mapBytes - offset),
+				offset);
+	dirty[i] = FALSE;
+    }
+}
+
+//----------------------------------------------------------------------
+// PersistentBitmap::CountGroups
+// 	Count the clear bits in each allocation group, after the bitmap
+//	was initialized as a whole.  A group is a whole number of words,
+//	so this goes a word at a time.
+//----------------------------------------------------------------------
+
+void
+PersistentBitmap::CountGroups()
+{
+    ASSERT(SectorsPerGroup % BitsInWord == 0);
+    for (int g = 0; g < numGroups; g++)
+	groupFree[g] = 0;
+    for (int w = 0; w < numWords; w++)
+	groupFree[GroupOf(w * BitsInWord)] += WordClear(w);
+}
+
+//----------------------------------------------------------------------
+// PersistentBitmap::EmptiestGroup
+// 	Return the allocation group with the most clear bits.  Among
+//	groups with as many, the first one after "after", so that on an
+//	empty disk successive directories go to successive groups.
+//
+//	"after" -- the group to start looking after
+//----------------------------------------------------------------------
+
+int
+PersistentBitmap::EmptiestGroup(int after)
+{
+    int best = after;
+
+    for (int i = 1; i <= numGroups; i++) {
+	int g = (after + i) % numGroups;
+	if (groupFree[g] > groupFree[best])
+	    best = g;
+    }
+    return best;
 }
@@ -6,6 +6,20 @@
 //    when it is created, or it can be initialized later using
 //    the FetchFrom method
 //
+//    The bitmap remembers which sectors of its file hold bits that
+//    changed since it was last fetched or written back, and only
+//    writes those sectors back.
+//
+//    The sectors of the file are also written in order, the first
+//    time: only the first so many have ever been written (the
+//    "watermark", kept by the file system in its superblock), and the
+//    bits in the rest are all clear, and are not read.  So a new file
+//    system does not have to write the whole bitmap, nor read it.
+//
+//    The bits are also divided into allocation groups of whole disk
+//    tracks, as in the BSD fast file system, and the bitmap keeps count
+//    of the clear bits in each group, to decide where new things go.
+//
 // Copyright (c) 1992,1993,1995 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
@@ -16,6 +30,10 @@
 #include "copyright.h"
 #include "bitmap.h"
 #include "openfile.h"
+#include "disk.h"
+
+#define TracksPerGroup		4	// disk tracks in an allocation group
+#define SectorsPerGroup		(TracksPerGroup * SectorsPerTrack)
 
 // The following class defines a persistent bitmap.  It inherits all
 // the behavior of a bitmap (see bitmap.h), adding the ability to
@@ -23,13 +41,38 @@
 
 class PersistentBitmap : public Bitmap {
   public:
-    PersistentBitmap(OpenFile *file,int numItems); //initialize bitmap from disk 
+    PersistentBitmap(OpenFile *file, int numItems, int numWritten);
+					// initialize bitmap from disk, where
+					// "numWritten" sectors of it are
     PersistentBitmap(int numItems); // or don't...
 
     ~PersistentBitmap(); 			// deallocate bitmap
 
+    void Mark(int which);		// Set/clear the "nth" bit, and
+    void Clear(int which);		// remember its sector is dirty
+
+    int AllocateHeader(int parent, bool isDirectory);
+					// Find and set a bit for the header
+					// of a new file in the directory
+					// whose header is "parent"
+
     void FetchFrom(OpenFile *file);     // read bitmap from the disk
-    void WriteBack(OpenFile *file); 	// write bitmap contents to disk 
+    void WriteBack(OpenFile *file); 	// write the changed sectors of the
+					// bitmap to disk
+    int NumWritten() { return numWritten; }
+					// How many sectors of the file have
+					// ever been written?
+
+  private:
+    int numMapSectors;			// sectors in the bitmap file
+    bool *dirty;			// which of them have changed
+    int numWritten;			// sectors of the file written so
+					// far; the rest are all clear
+    int numGroups;			// allocation groups
+    int *groupFree;			// clear bits in each group
+
+    void CountGroups();			// Recompute "groupFree"
+    int EmptiestGroup(int after);	// Group with the most clear bits
 };
 
 #endif // PBITMAP_H
@@ -0,0 +1,646 @@
+// sectorcache.cc
+//	Routines to cache disk sectors in memory.  See sectorcache.h
+//	for how the cache behaves.
+//
+//	Every buffer is always on the LRU list; a buffer holding a sector
+//	is also on the hash chain for that sector.  Buffers that have a
+//	disk transfer in progress are "busy": they are never chosen for
+//	replacement, and threads that want one wait on "ioDone".  Pinned
+//	buffers are never chosen for replacement either, and are skipped
+//	when writing back.  A buffer is only "logged" as long as it holds
+//	what the journal copied out of it: writing it clears the flag.
+//
+//	Read ahead is done by a separate thread, like the postal worker
+//	in network/post.cc: the buffers it fills must be claimed and
+//	released under the cache lock, which an interrupt handler
+//	cannot take.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "sectorcache.h"
+#include "synchdisk.h"
+#include "main.h"
+
+//----------------------------------------------------------------------
+// SectorCache::SectorCache
+// 	Initialize an empty sector cache, and start the thread that reads
+//	sectors into it ahead of time.
+//
+//	"disk" -- the synchronous disk to cache sectors of
+//----------------------------------------------------------------------
+
+SectorCache::SectorCache(SynchDisk *disk)
+{
+    synchDisk = disk;
+    entries = new CacheEntry[NumCacheSectors];
+    hashTable = new CacheEntry *[CacheHashSize];
+    lock = new Lock("sector cache lock");
+    ioDone = new Condition("sector cache io");
+    aheadQueue = new List<ReadAheadRequest *>;
+    aheadWanted = new Semaphore("read ahead wanted", 0);
+
+    for (int i = 0; i < CacheHashSize; i++)
+	hashTable[i] = NULL;
+    for (int i = 0; i < NumCacheSectors; i++) {
+	entries[i].sector = -1;
+	entries[i].dirty = FALSE;
+	entries[i].busy = FALSE;
+	entries[i].pins = 0;
+	entries[i].logged = FALSE;
+	entries[i].hashNext = NULL;
+	entries[i].lruPrev = (i > 0) ? &entries[i - 1] : NULL;
+	entries[i].lruNext = (i < NumCacheSectors - 1) ? &entries[i + 1] : NULL;
+	memset(entries[i].data, 0, SectorSize);	// keep valgrind happy
+    }
+    lruHead = &entries[0];
+    lruTail = &entries[NumCacheSectors - 1];
+
+    Thread *t = new Thread("read ahead worker", 1);
+
+    t->Fork(SectorCache::ReadAheadWorker, this);
+}
+
+//----------------------------------------------------------------------
+// SectorCache::~SectorCache
+// 	De-allocate the cache.  Anything still dirty is lost, so the
+//	kernel flushes the cache before it shuts down.
+//
+//	Since the read ahead worker is waiting on "aheadWanted", we don't
+//	deallocate it, as for the postal worker.
+//----------------------------------------------------------------------
+
+SectorCache::~SectorCache()
+{
+    while (!aheadQueue->IsEmpty())
+	delete aheadQueue->RemoveFront();
+    delete aheadQueue;
+    delete ioDone;
+    delete lock;
+    delete [] hashTable;
+    delete [] entries;
+}
+
+//----------------------------------------------------------------------
+// SectorCache::ReadSector
+// 	Read the contents of a disk sector into a buffer, from the cache
+//	if possible.
+//
+//	"sectorNumber" -- the disk sector to read
+//	"data" -- the buffer to hold the contents of the disk sector
+//----------------------------------------------------------------------
+
+void
+SectorCache::ReadSector(int sectorNumber, char* data)
+{
+    CacheEntry *e;
+
+    lock->Acquire();
+    e = GetEntry(sectorNumber, TRUE);
+    bcopy(e->data, data, SectorSize);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SectorCache::WriteSector
+// 	Write the contents of a buffer into the cached copy of a disk
+//	sector.  The sector is only written to disk later.  Since the whole
+//	sector is overwritten, a sector that is not cached is not read in.
+//
+//	"sectorNumber" -- the disk sector to be written
+//	"data" -- the new contents of the disk sector
+//----------------------------------------------------------------------
+
+void
+SectorCache::WriteSector(int sectorNumber, char* data)
+{
+    CacheEntry *e;
+
+    lock->Acquire();
+    e = GetEntry(sectorNumber, FALSE);
+    bcopy(data, e->data, SectorSize);
+    e->dirty = TRUE;
+    e->logged = FALSE;
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SectorCache::WritePinned
+// 	Write the contents of a buffer into the cached copy of a disk
+//	sector, like WriteSector, and pin the buffer: it stays in the
+//	cache, and is not written to disk, until it is unpinned.
+//
+//	"sectorNumber" -- the disk sector to be written
+//	"data" -- the new contents of the disk sector
+//----------------------------------------------------------------------
+
+void
+SectorCache::WritePinned(int sectorNumber, char* data)
+{
+    CacheEntry *e;
+
+    lock->Acquire();
+    e = GetEntry(sectorNumber, FALSE);
+    bcopy(data, e->data, SectorSize);
+    e->dirty = TRUE;
+    e->logged = FALSE;
+    e->pins++;
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SectorCache::Unpin
+// 	Drop one pin on the buffer for "sectorNumber"; with none left, it
+//	can be written back and replaced again.
+//
+//	"sectorNumber" -- the disk sector, which must be pinned
+//----------------------------------------------------------------------
+
+void
+SectorCache::Unpin(int sectorNumber)
+{
+    CacheEntry *e;
+
+    lock->Acquire();
+    e = Lookup(sectorNumber);
+    ASSERT(e != NULL && e->pins > 0);
+    if (--e->pins == 0)
+	ioDone->Broadcast(lock);	// someone may be waiting for a buffer
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SectorCache::CopyLogged
+// 	Copy the contents of a pinned buffer, for the journal to write to
+//	its log, and mark the buffer logged: until it is written again,
+//	writing it back can wait.
+//
+//	"sectorNumber" -- the disk sector, which must be pinned
+//	"data" -- the buffer to hold the contents of the disk sector
+//----------------------------------------------------------------------
+
+void
+SectorCache::CopyLogged(int sectorNumber, char* data)
+{
+    CacheEntry *e;
+
+    lock->Acquire();
+    e = Lookup(sectorNumber);
+    ASSERT(e != NULL && e->pins > 0 && !e->busy);
+    bcopy(e->data, data, SectorSize);
+    e->logged = TRUE;
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SectorCache::WriteLogged
+// 	Write the contents of a sector that the journal found in its log,
+//	when the disk is mounted, into the cache.  The buffer is logged,
+//	like those the journal has just committed.
+//
+//	"sectorNumber" -- the disk sector to be written
+//	"data" -- the contents of the disk sector, from the log
+//----------------------------------------------------------------------
+
+void
+SectorCache::WriteLogged(int sectorNumber, char* data)
+{
+    CacheEntry *e;
+
+    lock->Acquire();
+    e = GetEntry(sectorNumber, FALSE);
+    bcopy(data, e->data, SectorSize);
+    e->dirty = TRUE;
+    e->logged = TRUE;
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SectorCache::ReadSectors
+// 	Read the contents of "count" consecutive disk sectors into a
+//	buffer, from the cache where possible.  Each run of sectors that
+//	are not cached is read from disk in one request.
+//
+//	If "data" is NULL, the sectors are only brought into the cache;
+//	sectors already there (or on their way) are left alone.
+//
+//	"sectorNumber" -- the first disk sector to read
+//	"data" -- the buffer to hold the contents of the disk sectors,
+//		or NULL
+//	"count" -- the number of sectors to read
+//----------------------------------------------------------------------
+
+void
+SectorCache::ReadSectors(int sectorNumber, char* data, int count)
+{
+    CacheEntry *run[CacheRunSectors];
+    char *buffers[CacheRunSectors];
+    CacheEntry *e;
+    int i, n;
+
+    lock->Acquire();
+    for (i = 0; i < count; i += n) {
+	if (Lookup(sectorNumber + i) != NULL) {
+	    n = 1;
+	    if (data == NULL)
+		continue;
+	    e = GetEntry(sectorNumber + i, TRUE);
+	    bcopy(e->data, &data[i * SectorSize], SectorSize);
+	    continue;
+	}
+
+	// claim buffers for this sector and the uncached ones after it;
+	// they stay busy, so nobody looks at them until they are read in
+	n = 0;
+	while (i + n < count && n < CacheRunSectors
+			&& Lookup(sectorNumber + i + n) == NULL) {
+	    e = NewEntry(sectorNumber + i + n);
+	    if (e == NULL)
+		continue;		// lock was released; look again
+	    if (data != NULL)
+		kernel->stats->numCacheMisses++;	// not read ahead
+	    e->busy = TRUE;
+	    run[n] = e;
+	    buffers[n] = e->data;
+	    n++;
+	}
+	if (n == 0)
+	    continue;			// someone else read it in meanwhile
+
+	lock->Release();
+	synchDisk->ReadSectors(sectorNumber + i, buffers, n);
+	lock->Acquire();
+	for (int j = 0; j < n; j++) {
+	    run[j]->busy = FALSE;
+	    if (data != NULL)
+		bcopy(run[j]->data, &data[(i + j) * SectorSize], SectorSize);
+	}
+	if (data == NULL)
+	    kernel->stats->numReadAheads += n;
+	ioDone->Broadcast(lock);
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SectorCache::ReadAhead
+// 	Ask the read ahead worker to bring "count" consecutive disk
+//	sectors into the cache, and return without waiting.  If too many
+//	requests are already waiting, this one is dropped; it is only a
+//	hint.
+//
+//	"sectorNumber" -- the first disk sector to read
+//	"count" -- the number of sectors to read
+//----------------------------------------------------------------------
+
+void
+SectorCache::ReadAhead(int sectorNumber, int count)
+{
+    ReadAheadRequest *request;
+
+    ASSERT((sectorNumber >= 0) && (sectorNumber + count <= NumSectors));
+    lock->Acquire();
+    if (aheadQueue->NumInList() >= MaxReadAheads) {
+	lock->Release();
+	return;
+    }
+    request = new ReadAheadRequest;
+    request->sector = sectorNumber;
+    request->count = count;
+    aheadQueue->Append(request);
+    lock->Release();
+    aheadWanted->V();
+}
+
+//----------------------------------------------------------------------
+// SectorCache::ReadAheadWorker
+// 	Wait for runs of sectors to read ahead, and read them into the
+//	cache, one at a time.
+//----------------------------------------------------------------------
+
+void
+SectorCache::ReadAheadWorker(void *data)
+{
+    SectorCache *_this = (SectorCache *) data;
+    ReadAheadRequest *request;
+
+    for (;;) {
+	_this->aheadWanted->P();
+	_this->lock->Acquire();
+	request = _this->aheadQueue->RemoveFront();
+	_this->lock->Release();
+	DEBUG(dbgFile, "Reading ahead " << request->count
+			<< " sectors at " << request->sector);
+	_this->ReadSectors(request->sector, NULL, request->count);
+	delete request;
+    }
+}
+
+//----------------------------------------------------------------------
+// SectorCache::Flush
+// 	Write every dirty buffer back to disk, in sector order (and in
+//	runs, where the sectors are consecutive), and return once they
+//	have all been written, all the way to the disk's UNIX file.
+//	Pinned buffers are left dirty.
+//----------------------------------------------------------------------
+
+void
+SectorCache::Flush()
+{
+    CacheEntry *e;
+
+    lock->Acquire();
+    while ((e = FindDirty(TRUE)) != NULL)
+	WriteBack(e);
+    lock->Release();
+    synchDisk->Sync();
+}
+
+//----------------------------------------------------------------------
+// SectorCache::FlushUnlogged
+// 	Write every dirty buffer back to disk, like Flush, except those
+//	the journal has a copy of in its log.
+//----------------------------------------------------------------------
+
+void
+SectorCache::FlushUnlogged()
+{
+    CacheEntry *e;
+
+    lock->Acquire();
+    while ((e = FindDirty(FALSE)) != NULL)
+	WriteBack(e);
+    lock->Release();
+    synchDisk->Sync();
+}
+
+//----------------------------------------------------------------------
+// SectorCache::FlushBehind
+// 	Start writing back the lowest-numbered dirty buffer, without
+//	waiting for the write to finish.  Return TRUE if a write was
+//	started.  Logged buffers are left for later: Nachos can stop
+//	without writing them back.
+//
+//	This is called from Kernel::PrepareToEnd, when every thread is
+//	blocked and interrupts are off, so we cannot wait for the cache
+//	lock.  We do not need it either: a thread only ever blocks while
+//	holding the lock if it is waiting on the disk, and then
+//	SynchDisk::WriteBehind refuses the request.
+//----------------------------------------------------------------------
+
+bool
+SectorCache::FlushBehind()
+{
+    CacheEntry *e;
+
+    ASSERT(kernel->interrupt->getLevel() == IntOff);
+    if ((e = FindDirty(FALSE)) == NULL)
+	return FALSE;
+    if (!synchDisk->WriteBehind(e->sector, e->data))
+	return FALSE;			// disk busy, try again later
+    e->dirty = FALSE;
+    e->logged = FALSE;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// SectorCache::NumDirty
+// 	Return the number of buffers waiting to be written back.
+//----------------------------------------------------------------------
+
+int
+SectorCache::NumDirty()
+{
+    int count = 0;
+
+    for (int i = 0; i < NumCacheSectors; i++)
+	if (entries[i].dirty)
+	    count++;
+    return count;
+}
+
+//----------------------------------------------------------------------
+// SectorCache::Lookup
+// 	Return the buffer holding "sectorNumber", or NULL if the sector
+//	is not cached.
+//----------------------------------------------------------------------
+
+CacheEntry *
+SectorCache::Lookup(int sectorNumber)
+{
+    CacheEntry *e;
+
+    for (e = hashTable[sectorNumber % CacheHashSize]; e != NULL;
+						e = e->hashNext)
+	if (e->sector == sectorNumber)
+	    return e;
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// SectorCache::GetEntry
+// 	Return the buffer for "sectorNumber", making it the most recently
+//	used.  On a miss, a buffer is reclaimed for the sector, and if
+//	"fill" is set, the sector is read in from disk.
+//
+//	Called with the cache lock held; the lock is released while waiting
+//	for the disk, so on every wakeup we start the search over.
+//----------------------------------------------------------------------
+
+CacheEntry *
+SectorCache::GetEntry(int sectorNumber, bool fill)
+{
+    CacheEntry *e;
+
+    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+    for (;;) {
+	e = Lookup(sectorNumber);
+	if (e != NULL) {
+	    if (e->busy) {			// wait for the transfer
+		ioDone->Wait(lock);
+		continue;
+	    }
+	    kernel->stats->numCacheHits++;
+	    MoveToFront(e);
+	    return e;
+	}
+
+	e = NewEntry(sectorNumber);
+	if (e == NULL)				// had to wait; retry
+	    continue;
+	kernel->stats->numCacheMisses++;
+	if (fill) {
+	    e->busy = TRUE;
+	    lock->Release();
+	    synchDisk->ReadSector(sectorNumber, e->data);
+	    lock->Acquire();
+	    e->busy = FALSE;
+	    ioDone->Broadcast(lock);
+	}
+	return e;
+    }
+}
+
+//----------------------------------------------------------------------
+// SectorCache::NewEntry
+// 	Reclaim the least recently used idle buffer for "sectorNumber",
+//	which must not be cached, and return it; its contents are stale
+//	until the caller fills it in.
+//
+//	If every buffer is busy or pinned, or the buffer has to be written
+//	back first, the cache lock is released while waiting, and we return
+//	NULL: the caller must look the sector up again.
+//----------------------------------------------------------------------
+
+CacheEntry *
+SectorCache::NewEntry(int sectorNumber)
+{
+    CacheEntry *e = FindVictim();
+
+    if (e == NULL) {				// every buffer is busy (or pinned)
+	ioDone->Wait(lock);
+	return NULL;
+    }
+    if (e->dirty) {
+	WriteBack(e);
+	return NULL;
+    }
+
+    if (e->sector != -1) {
+	kernel->stats->numCacheEvictions++;
+	HashRemove(e);
+    }
+    e->sector = sectorNumber;
+    HashInsert(e);
+    MoveToFront(e);
+    return e;
+}
+
+//----------------------------------------------------------------------
+// SectorCache::WriteBack
+// 	Write a dirty buffer back to disk, together with the dirty idle
+//	buffers for the sectors right after it, in one disk request.
+//
+//	Called with the cache lock held; the lock is released while
+//	waiting for the disk.
+//
+//	"e" -- a dirty buffer that is not busy
+//----------------------------------------------------------------------
+
+void
+SectorCache::WriteBack(CacheEntry *e)
+{
+    CacheEntry *run[CacheRunSectors];
+    char *buffers[CacheRunSectors];
+    int n = 0;
+
+    ASSERT(e->dirty && !e->busy && e->pins == 0);
+    while (e != NULL && e->dirty && !e->busy && e->pins == 0
+					&& n < CacheRunSectors) {
+	e->busy = TRUE;
+	e->dirty = FALSE;
+	e->logged = FALSE;
+	run[n] = e;
+	buffers[n] = e->data;
+	n++;
+	e = Lookup(e->sector + 1);
+    }
+
+    lock->Release();
+    synchDisk->WriteSectors(run[0]->sector, buffers, n);
+    lock->Acquire();
+    for (int i = 0; i < n; i++)
+	run[i]->busy = FALSE;
+    ioDone->Broadcast(lock);
+}
+
+//----------------------------------------------------------------------
+// SectorCache::FindVictim
+// 	Return the least recently used buffer that is neither busy nor
+//	pinned, or NULL if there is none.
+//----------------------------------------------------------------------
+
+CacheEntry *
+SectorCache::FindVictim()
+{
+    CacheEntry *e;
+
+    for (e = lruTail; e != NULL; e = e->lruPrev)
+	if (!e->busy && e->pins == 0)
+	    return e;
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// SectorCache::FindDirty
+// 	Return the dirty buffer with the lowest sector number that is
+//	neither busy nor pinned (nor logged, unless "logged" is set), or
+//	NULL if there is none.  Writing back in sector order keeps the
+//	disk head moving in one direction.
+//----------------------------------------------------------------------
+
+CacheEntry *
+SectorCache::FindDirty(bool logged)
+{
+    CacheEntry *found = NULL;
+
+    for (int i = 0; i < NumCacheSectors; i++) {
+	CacheEntry *e = &entries[i];
+	if (e->dirty && !e->busy && e->pins == 0 && (logged || !e->logged)
+		&& (found == NULL || e->sector < found->sector))
+	    found = e;
+    }
+    return found;
+}
+
+//----------------------------------------------------------------------
+// SectorCache::HashInsert/HashRemove
+// 	Add or remove a buffer on the hash chain for its sector.
+//----------------------------------------------------------------------
+
+void
+SectorCache::HashInsert(CacheEntry *e)
+{
+    int bucket = e->sector % CacheHashSize;
+
+    e->hashNext = hashTable[bucket];
+    hashTable[bucket] = e;
+}
+
+void
+SectorCache::HashRemove(CacheEntry *e)
+{
+    CacheEntry **p = &hashTable[e->sector % CacheHashSize];
+
+    while (*p != e) {
+	ASSERT(*p != NULL);
+	p = &(*p)->hashNext;
+    }
+    *p = e->hashNext;
+    e->hashNext = NULL;
+}
+
+//----------------------------------------------------------------------
+// SectorCache::MoveToFront
+// 	Make a buffer the most recently used one.
+//----------------------------------------------------------------------
+
+void
+SectorCache::MoveToFront(CacheEntry *e)
+{
+    if (e == lruHead)
+	return;
+    // unlink
+    e->lruPrev->lruNext = e->lruNext;
+    if (e->lruNext != NULL)
+	e->lruNext->lruPrev = e->lruPrev;
+    else
+	lruTail = e->lruPrev;
+    // put at the head
+    e->lruPrev = NULL;
+    e->lruNext = lruHead;
+    lruHead->lruPrev = e;
+    lruHead = e;
+}
@@ -0,0 +1,172 @@
+// sectorcache.h
+//	Data structures for a kernel-wide cache of disk sectors, layered
+//	on top of the synchronous disk.
+//
+//	The file system reads the same file header and directory sectors
+//	over and over again; the cache keeps a fixed pool of sector
+//	buffers in memory so that repeated accesses do not go to disk.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef SECTORCACHE_H
+#define SECTORCACHE_H
+
+#include "disk.h"
+#include "synch.h"
+#include "list.h"
+
+class SynchDisk;
+
+#define NumCacheSectors		1024	// number of sector buffers; enough
+					// to hold the free map file along
+					// with the hot headers and directories
+#define CacheHashSize		256	// number of hash buckets
+#define CacheRunSectors		32	// most sectors read or written
+					// back in one disk request
+#define MaxReadAheads		8	// most read ahead requests waiting
+
+// The following class defines one buffer in the sector cache.
+//
+// Internal data structures kept public so that SectorCache operations can
+// access them directly.
+
+class CacheEntry {
+  public:
+    int sector;				// Disk sector held in this buffer,
+					//   -1 if the buffer is empty
+    bool dirty;				// Modified since it was last written?
+    bool busy;				// Is a disk transfer in progress?
+    int pins;				// Uncommitted journal transactions
+					//   holding the buffer; it is not
+					//   written back until this is 0
+    bool logged;			// Dirty, but the journal's log has
+					//   these contents, so writing it
+					//   back can wait
+    CacheEntry *hashNext;		// Next buffer in the same hash bucket
+    CacheEntry *lruPrev;		// Neighbours in least-recently-used
+    CacheEntry *lruNext;		//   order (head is most recent)
+    char data[SectorSize];		// Contents of the sector
+};
+
+// A run of sectors to be read into the cache ahead of time.
+
+class ReadAheadRequest {
+  public:
+    int sector;				// First sector of the run
+    int count;				// Number of sectors
+};
+
+// The following class defines the sector cache.  It exports the same
+// ReadSector/WriteSector interface as SynchDisk, so the file system can
+// simply call the cache instead of the disk.
+//
+// Lookup is by hashing the sector number.  When a buffer is needed for
+// a sector that is not cached, the least recently used buffer is
+// reclaimed; if it is dirty, it is first written back to disk.
+// Writes only update the buffer (write-back); dirty buffers reach the
+// disk on eviction, on Flush, or one at a time through FlushBehind
+// when the machine is about to go idle.
+//
+// Sectors that are consecutive on disk move in runs: ReadSectors reads
+// all the missing sectors of a run in one disk request, and writing a
+// dirty buffer back also writes the dirty buffers for the sectors
+// right after it.
+//
+// The journal pins the buffers of sectors it has logged, until the log
+// is on disk; a pinned buffer is neither written back nor replaced.
+// Once the log is on disk, the buffer is "logged": it is written back
+// when it is replaced, or by Flush, but FlushBehind and FlushUnlogged
+// leave it alone, since the journal can recover its contents.
+//
+// ReadAhead asks for a run of sectors to be brought into the cache
+// without waiting for them.  A kernel thread, the "read ahead worker",
+// reads them in; threads that want one of the sectors before it
+// arrives wait for it as for any other busy buffer.
+//
+// The cache lock is not held while a thread waits for the disk, so
+// other threads can hit in the cache in the meantime; a buffer with a
+// transfer in progress is marked "busy" and threads that need it wait
+// for the transfer to finish.
+
+class SectorCache {
+  public:
+    SectorCache(SynchDisk *disk);	// Initialize an empty cache on
+					// top of "disk"
+    ~SectorCache();			// De-allocate the cache; dirty
+					// buffers must be flushed first
+
+    void ReadSector(int sectorNumber, char* data);
+    					// Read/write a whole sector through
+					// the cache
+    void WriteSector(int sectorNumber, char* data);
+    void WritePinned(int sectorNumber, char* data);
+					// Same, and pin the buffer
+    void Unpin(int sectorNumber);	// Drop one pin on a buffer
+    void CopyLogged(int sectorNumber, char* data);
+					// Copy out a pinned buffer for the
+					// log, and mark it logged
+    void WriteLogged(int sectorNumber, char* data);
+					// Write a sector found in the log
+
+    void ReadSectors(int sectorNumber, char* data, int count);
+					// Read "count" consecutive sectors
+					// through the cache, fetching the
+					// missing ones in runs; with "data"
+					// NULL, just bring them into the cache
+    void ReadAhead(int sectorNumber, int count);
+					// Start bringing "count" consecutive
+					// sectors into the cache, without
+					// waiting for them
+
+    void Flush();			// Write all dirty buffers that are
+					// not pinned back to disk, waiting
+					// until they are done
+    void FlushUnlogged();		// Same, but leave logged buffers
+    bool FlushBehind();			// Start writing back one dirty
+					// buffer without waiting; return
+					// FALSE if there was nothing to do.
+					// Called with interrupts off, when
+					// no thread is ready to run.
+    int NumDirty();			// Number of dirty buffers
+
+  private:
+    SynchDisk *synchDisk;		// Disk underneath the cache
+    CacheEntry *entries;		// The pool of sector buffers
+    CacheEntry **hashTable;		// Buckets of buffers, by sector
+    CacheEntry *lruHead;		// Most recently used buffer
+    CacheEntry *lruTail;		// Least recently used buffer
+    Lock *lock;				// Mutual exclusion on the cache
+    Condition *ioDone;			// Signalled when a busy buffer
+					// becomes available again
+    List<ReadAheadRequest *> *aheadQueue;
+					// Runs waiting to be read ahead
+    Semaphore *aheadWanted;		// Counts the runs waiting
+
+    static void ReadAheadWorker(void *data);
+					// Read in the runs waiting, forever
+
+    CacheEntry *Lookup(int sectorNumber);
+					// Find the buffer for a sector
+    CacheEntry *GetEntry(int sectorNumber, bool fill);
+					// Find or allocate the buffer for
+					// a sector, reading it from disk
+					// if "fill"
+    CacheEntry *NewEntry(int sectorNumber);
+					// Reclaim a buffer for a sector
+					// that is not cached
+    void WriteBack(CacheEntry *e);	// Write a dirty buffer, and those
+					// following it on disk, to disk
+    CacheEntry *FindVictim();		// Least recently used idle buffer
+    CacheEntry *FindDirty(bool logged);	// Lowest-numbered dirty buffer
+					// that can be written back (and
+					// is not logged, unless "logged")
+    void HashInsert(CacheEntry *e);
+    void HashRemove(CacheEntry *e);
+    void MoveToFront(CacheEntry *e);	// Mark a buffer most recently used
+};
+
+#endif // SECTORCACHE_H
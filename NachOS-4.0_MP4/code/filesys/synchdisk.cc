@@ -5,10 +5,26 @@
 //	the disk providing a synchronous interface (requests wait until
 //	the request completes).
 //
-//	Use a semaphore to synchronize the interrupt handlers with the
-//	pending requests.  And, because the physical disk can only
-//	handle one operation at a time, use a lock to enforce mutual
-//	exclusion.
+//	Each request has a semaphore, to synchronize the interrupt
+//	handler with the thread waiting for it.  Because the physical
+//	disk can only handle one operation at a time, requests that
+//	arrive while it is busy wait in a queue; when the disk finishes
+//	a request, the interrupt handler picks the next one according to
+//	the scheduling policy and starts it.  The queue is only touched
+//	with interrupts off.
+//
+//	With several threads doing I/O, picking requests by their
+//	position on the disk rather than their arrival order cuts down on
+//	seeks.  SCAN and C-LOOK also keep any request from waiting
+//	forever, which SSTF does not.
+//
+//	A request may cover a run of consecutive sectors, which the disk
+//	transfers with a single seek and a single interrupt; the sector
+//	cache reads and writes back contiguous sectors this way.
+//
+//	A sector can also be written "behind": the request is started
+//	and the caller goes on without waiting.  The sector cache uses
+//	this to drain dirty sectors when every thread is blocked.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -16,6 +32,7 @@
 
 #include "copyright.h"
 #include "synchdisk.h"
+#include "main.h"
 
 
 //----------------------------------------------------------------------
@@ -23,12 +40,27 @@
 // 	Initialize the synchronous interface to the physical disk, in turn
 //	initializing the physical disk.
 //
+//	"policyName" -- the order in which to serve waiting requests
 //----------------------------------------------------------------------
 
-SynchDisk::SynchDisk()
+SynchDisk::SynchDisk(char *policyName)
 {
-    semaphore = new Semaphore("synch disk", 0);
-    lock = new Lock("synch disk lock");
+    if (policyName == NULL || !strcmp(policyName, "clook"))
+	policy = DiskCLOOK;
+    else if (!strcmp(policyName, "fcfs"))
+	policy = DiskFCFS;
+    else if (!strcmp(policyName, "sstf"))
+	policy = DiskSSTF;
+    else if (!strcmp(policyName, "scan"))
+	policy = DiskSCAN;
+    else {
+	cerr << "Unknown disk policy " << policyName << "\n";
+	Abort();
+    }
+    queue = new List<DiskRequest *>;
+    active = NULL;
+    headSector = 0;
+    sweepingUp = TRUE;
     disk = new Disk(this);
 }
 
@@ -41,8 +73,7 @@ SynchDisk::SynchDisk()
 SynchDisk::~SynchDisk()
 {
     delete disk;
-    delete lock;
-    delete semaphore;
+    delete queue;
 }
 
 //----------------------------------------------------------------------
@@ -57,10 +88,7 @@ SynchDisk::~SynchDisk()
 void
 SynchDisk::ReadSector(int sectorNumber, char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->ReadRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
-    lock->Release();
+    ReadSectors(sectorNumber, &data, 1);
 }
 
 //----------------------------------------------------------------------
@@ -75,20 +103,232 @@ SynchDisk::ReadSector(int sectorNumber, char* data)
 void
 SynchDisk::WriteSector(int sectorNumber, char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->WriteRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
-    lock->Release();
+    WriteSectors(sectorNumber, &data, 1);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::ReadSectors
+// 	Read a run of consecutive disk sectors, each into its own buffer,
+//	in a single disk request.  Return only after the data has been
+//	read.
+//
+//	"sectorNumber" -- the first disk sector to read
+//	"data" -- the buffers to hold the contents of the sectors
+//	"count" -- the number of sectors to read
+//----------------------------------------------------------------------
+
+void
+SynchDisk::ReadSectors(int sectorNumber, char** data, int count)
+{
+    Semaphore done("synch disk request", 0);
+    DiskRequest request;
+
+    request.sector = sectorNumber;
+    request.count = count;
+    request.data = data;
+    request.writing = FALSE;
+    request.done = &done;
+    Submit(&request);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::WriteSectors
+// 	Write a run of consecutive disk sectors, each from its own buffer,
+//	in a single disk request.  Return only after the data has been
+//	written.
+//
+//	"sectorNumber" -- the first disk sector to be written
+//	"data" -- the new contents of the sectors
+//	"count" -- the number of sectors to write
+//----------------------------------------------------------------------
+
+void
+SynchDisk::WriteSectors(int sectorNumber, char** data, int count)
+{
+    Semaphore done("synch disk request", 0);
+    DiskRequest request;
+
+    request.sector = sectorNumber;
+    request.count = count;
+    request.data = data;
+    request.writing = TRUE;
+    request.done = &done;
+    Submit(&request);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Sync
+// 	Make sure every sector written so far has reached the UNIX file
+//	that simulates the disk (see Disk::Sync).
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Sync()
+{
+    disk->Sync();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::IsBusy
+// 	Return TRUE if the disk is serving a request.  Called with
+//	interrupts off, or the answer may be stale by the time it is used.
+//----------------------------------------------------------------------
+
+bool
+SynchDisk::IsBusy()
+{
+    return active != NULL;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::WriteBehind
+// 	Start writing a buffer into a disk sector, and return right away.
+//	The data is copied, so the caller may reuse its buffer.
+//	Return FALSE, without doing anything, if the disk is busy.
+//
+//	Interrupts must be off, so that no request can slip in between
+//	checking the disk and starting the write.
+//
+//	"sectorNumber" -- the disk sector to be written
+//	"data" -- the new contents of the disk sector
+//----------------------------------------------------------------------
+
+bool
+SynchDisk::WriteBehind(int sectorNumber, char* data)
+{
+    ASSERT(kernel->interrupt->getLevel() == IntOff);
+    if (active != NULL)
+	return FALSE;
+    bcopy(data, behindData, SectorSize);
+    behindBuffer = behindData;
+    behindRequest.sector = sectorNumber;
+    behindRequest.count = 1;
+    behindRequest.data = &behindBuffer;
+    behindRequest.writing = TRUE;
+    behindRequest.done = NULL;
+    Start(&behindRequest);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Submit
+// 	Send a request to the disk if it is idle; otherwise, queue it
+//	until the disk gets to it.  Return once it is done.
+//
+//	"request" -- the request to serve
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Submit(DiskRequest *request)
+{
+    IntStatus oldLevel = kernel->interrupt->SetLevel(IntOff);
+
+    if (active == NULL)
+	Start(request);
+    else {
+	queue->Append(request);
+	kernel->stats->numDiskQueued += queue->NumInList();
+	kernel->stats->maxDiskQueue = max(kernel->stats->maxDiskQueue,
+						(int) queue->NumInList());
+    }
+    (void) kernel->interrupt->SetLevel(oldLevel);
+    request->done->P();			// wait for interrupt
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Start
+// 	Send a request to the disk, which must be idle.  Called with
+//	interrupts off.
+//
+//	"request" -- the request to start
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Start(DiskRequest *request)
+{
+    ASSERT(active == NULL);
+    active = request;
+    kernel->stats->numDiskSeekTracks += abs(request->sector / SectorsPerTrack
+					- headSector / SectorsPerTrack);
+    headSector = request->sector + request->count - 1;
+    if (request->writing)
+	disk->WriteRequest(request->sector, request->data, request->count);
+    else
+	disk->ReadRequest(request->sector, request->data, request->count);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::PickNext
+// 	Take the request the disk should serve next off the queue, which
+//	must not be empty.
+//
+//	FCFS takes the oldest request.  The others take the request the
+//	shortest way from the disk head, among the ones they will serve:
+//	SSTF in either direction; SCAN only in the direction the head is
+//	sweeping, until there are none left that way and it turns around;
+//	C-LOOK only ahead of the head, wrapping around to the lowest
+//	sector when there are none left.  Ties go to the oldest request.
+//----------------------------------------------------------------------
+
+DiskRequest *
+SynchDisk::PickNext()
+{
+    DiskRequest *best = NULL;
+    int bestDistance = 0;
+
+    ASSERT(!queue->IsEmpty());
+    if (policy == DiskFCFS)
+	return queue->RemoveFront();
+
+    while (best == NULL) {
+	ListIterator<DiskRequest *> iterator(queue);
+
+	for (; !iterator.IsDone(); iterator.Next()) {
+	    int sector = iterator.Item()->sector;
+	    int distance;
+
+	    switch (policy) {
+	      case DiskSSTF:
+		distance = abs(sector - headSector);
+		break;
+	      case DiskSCAN:
+		distance = sweepingUp ? sector - headSector
+					: headSector - sector;
+		break;
+	      default:			// DiskCLOOK
+		distance = (sector - headSector + NumSectors) % NumSectors;
+		break;
+	    }
+	    if (distance >= 0 && (best == NULL || distance < bestDistance)) {
+		best = iterator.Item();
+		bestDistance = distance;
+	    }
+	}
+	if (best == NULL) {
+	    ASSERT(policy == DiskSCAN);
+	    sweepingUp = !sweepingUp;	// nothing left this way; turn around
+	}
+    }
+    queue->Remove(best);
+    return best;
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::CallBack
-// 	Disk interrupt handler.  Wake up any thread waiting for the disk
-//	request to finish.
+// 	Disk interrupt handler.  Wake up the thread waiting for the disk
+//	request to finish (nobody waits for a WriteBehind), and start the
+//	next request, if any are waiting.
 //----------------------------------------------------------------------
 
 void
 SynchDisk::CallBack()
 { 
-    semaphore->V();
+    DiskRequest *finished = active;
+
+    ASSERT(finished != NULL);
+    active = NULL;
+    if (finished->done != NULL)
+	finished->done->V();
+    if (!queue->IsEmpty())
+	Start(PickNext());
 }
@@ -14,6 +14,32 @@
 #include "disk.h"
 #include "synch.h"
 #include "callback.h"
+#include "list.h"
+
+// The order in which requests waiting for the disk are sent to it.
+
+enum DiskPolicy {
+    DiskFCFS,				// in the order they were made
+    DiskSSTF,				// nearest to the disk head first
+    DiskSCAN,				// elevator: sweep the head up and
+					//  down, serving requests on the way
+    DiskCLOOK				// sweep up, serving requests on the
+					//  way, then jump back to the lowest
+};
+
+// A request for the disk, made by SynchDisk on behalf of a thread (or
+// of the sector cache, for a WriteBehind).
+
+class DiskRequest {
+  public:
+    int sector;				// First sector to read or write
+    int count;				// Number of consecutive sectors
+    char **data;			// Buffers to read into or write
+					// from, one per sector
+    bool writing;			// Write, rather than read?
+    Semaphore *done;			// Signalled when the request is
+					// complete; NULL if nobody waits
+};
 
 // The following class defines a "synchronous" disk abstraction.
 // As with other I/O devices, the raw physical disk is an asynchronous device --
@@ -24,21 +50,40 @@
 //
 // This class provides the abstraction that for any individual thread
 // making a request, it waits around until the operation finishes before
-// returning.
+// returning.  Requests that arrive while the disk is busy wait in a
+// queue, and are sent to the disk in the order chosen by the policy.
 
 class SynchDisk : public CallBackObj {
   public:
-    SynchDisk();    		        // Initialize a synchronous disk,
+    SynchDisk(char *policyName);	// Initialize a synchronous disk,
 					// by initializing the raw Disk.
+					// "policyName" is "fcfs", "sstf",
+					// "scan" or "clook" (the default,
+					// if NULL)
     ~SynchDisk();			// De-allocate the synch disk data
     
     void ReadSector(int sectorNumber, char* data);
     					// Read/write a disk sector, returning
     					// only once the data is actually read 
-					// or written.  These call
-    					// Disk::ReadRequest/WriteRequest and
-					// then wait until the request is done.
+					// or written.  These queue a request,
+					// and then wait until it is done.
     void WriteSector(int sectorNumber, char* data);
+
+    void ReadSectors(int sectorNumber, char** data, int count);
+    void WriteSectors(int sectorNumber, char** data, int count);
+					// Read/write a run of consecutive
+					// sectors, each with its own buffer,
+					// as one disk request
+
+    void Sync();			// Make sure everything written has
+					// reached the disk's UNIX file
+    bool IsBusy();			// Is the disk serving a request?
+
+    bool WriteBehind(int sectorNumber, char* data);
+					// Start writing a sector and return
+					// without waiting for it to finish.
+					// Returns FALSE if the disk is busy.
+					// Must be called with interrupts off.
     
     void CallBack();			// Called by the disk device interrupt
 					// handler, to signal that the
@@ -46,10 +91,23 @@ class SynchDisk : public CallBackObj {
 
   private:
     Disk *disk;		  		// Raw disk device
-    Semaphore *semaphore; 		// To synchronize requesting thread 
-					// with the interrupt handler
-    Lock *lock;		  		// Only one read/write request
-					// can be sent to the disk at a time
+    DiskPolicy policy;			// How to pick the next request
+    List<DiskRequest *> *queue;		// Requests waiting for the disk
+    DiskRequest *active;		// Request the disk is working on,
+					// or NULL if the disk is idle
+    int headSector;			// Sector of the last request sent
+					// to the disk
+    bool sweepingUp;			// SCAN: is the head moving toward
+					// higher sectors?
+    DiskRequest behindRequest;		// The WriteBehind request,
+    char behindData[SectorSize];	// a copy of the sector it writes,
+    char *behindBuffer;			// and the buffer list pointing to it
+
+    void Submit(DiskRequest *request);	// Start a request, or queue it,
+					// and wait for it to finish
+    void Start(DiskRequest *request);	// Send a request to the disk
+    DiskRequest *PickNext();		// Take the next request to start
+					// off the queue
 };
 
 #endif // SYNCHDISK_H
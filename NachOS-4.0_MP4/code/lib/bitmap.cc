@@ -1,6 +1,7 @@
 // bitmap.cc
 //	Routines to manage a bitmap -- an array of bits each of which
-//	can be either on or off.  Represented as an array of integers.
+//	can be either on or off.  Represented as an array of 64-bit words,
+//	with a summary of which words have clear bits in them.
 //
 // Copyright (c) 1992-1996 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -10,6 +11,28 @@
 #include "debug.h"
 #include "bitmap.h"
 
+// Operations on whole words, done by the host's bit instructions.
+
+static const BitWord AllOnes = ~(BitWord) 0;
+
+static inline int
+LowestBit(BitWord word)		// index of the lowest set bit; word != 0
+{
+    return __builtin_ctzll(word);
+}
+
+static inline int
+CountBits(BitWord word)		// number of set bits
+{
+    return __builtin_popcountll(word);
+}
+
+static inline BitWord
+BitsFrom(int bit)		// mask of the bits "bit" and up
+{
+    return AllOnes << bit;
+}
+
 //----------------------------------------------------------------------
 // BitMap::BitMap
 // 	Initialize a bitmap with "numItems" bits, so that every bit is clear.
@@ -20,19 +43,17 @@
 
 Bitmap::Bitmap(int numItems) 
 { 
-    int i;
-
     ASSERT(numItems > 0);
 
     numBits = numItems;
     numWords = divRoundUp(numBits, BitsInWord);
-    map = new unsigned int[numWords];
-    for (i = 0; i < numWords; i++) {
+    map = new BitWord[numWords];
+    numSummaryWords = divRoundUp(numWords, BitsInWord);
+    summary = new BitWord[numSummaryWords];
+    for (int i = 0; i < numWords; i++) {
 	map[i] = 0;		// initialize map to keep Purify happy
     }
-    for (i = 0; i < numBits; i++) {
-        Clear(i);
-    }
+    Rebuild();
 }
 
 //----------------------------------------------------------------------
@@ -43,6 +64,51 @@ Bitmap::Bitmap(int numItems)
 Bitmap::~Bitmap()
 { 
     delete [] map;
+    delete [] summary;
+}
+
+//----------------------------------------------------------------------
+// Bitmap::Rebuild
+// 	Recompute the summary and the number of clear bits from the
+//	words of the bitmap; called whenever "map" has been overwritten
+//	as a whole (for instance, read from disk).
+//
+//	The bits past numBits in the last word are kept set, so that
+//	searches never find them.
+//----------------------------------------------------------------------
+
+void
+Bitmap::Rebuild()
+{
+    if (numBits % BitsInWord != 0)
+	map[numWords - 1] |= BitsFrom(numBits % BitsInWord);
+
+    numClear = 0;
+    for (int i = 0; i < numSummaryWords; i++)
+	summary[i] = 0;
+    for (int i = 0; i < numWords; i++) {
+	numClear += BitsInWord - CountBits(map[i]);
+	UpdateSummary(i);
+    }
+}
+
+//----------------------------------------------------------------------
+// Bitmap::UpdateSummary
+// 	Set the summary bit of a word if it has any clear bit, and clear
+//	it otherwise.
+//
+//	"word" is the index of the word in "map".
+//----------------------------------------------------------------------
+
+void
+Bitmap::UpdateSummary(int word)
+{
+    BitWord bit = (BitWord) 1 << (word % BitsInWord);
+
+    if (map[word] != AllOnes)
+	summary[word / BitsInWord] |= bit;
+    else
+	summary[word / BitsInWord] &= ~bit;
 }
 
 //----------------------------------------------------------------------
@@ -55,9 +121,17 @@ Bitmap::~Bitmap()
 void
 Bitmap::Mark(int which) 
 { 
+    int word = which / BitsInWord;
+    BitWord bit = (BitWord) 1 << (which % BitsInWord);
+
     ASSERT(which >= 0 && which < numBits);
 
-    map[which / BitsInWord] |= 1 << (which % BitsInWord);
+    if (!(map[word] & bit)) {
+	map[word] |= bit;
+	numClear--;
+	if (map[word] == AllOnes)
+	    UpdateSummary(word);
+    }
 
     ASSERT(Test(which));
 }
@@ -72,9 +146,19 @@ Bitmap::Mark(int which)
 void 
 Bitmap::Clear(int which) 
 {
+    int word = which / BitsInWord;
+    BitWord bit = (BitWord) 1 << (which % BitsInWord);
+
     ASSERT(which >= 0 && which < numBits);
 
-    map[which / BitsInWord] &= ~(1 << (which % BitsInWord));
+    if (map[word] & bit) {
+	if (map[word] == AllOnes) {
+	    map[word] &= ~bit;
+	    UpdateSummary(word);
+	} else
+	    map[word] &= ~bit;
+	numClear++;
+    }
 
     ASSERT(!Test(which));
 }
@@ -91,7 +175,7 @@ Bitmap::Test(int which) const
 {
     ASSERT(which >= 0 && which < numBits);
     
-    if (map[which / BitsInWord] & (1 << (which % BitsInWord))) {
+    if (map[which / BitsInWord] & ((BitWord) 1 << (which % BitsInWord))) {
 	return TRUE;
     } else {
 	return FALSE;
@@ -110,13 +194,11 @@ Bitmap::Test(int which) const
 int 
 Bitmap::FindAndSet() 
 {
-    for (int i = 0; i < numBits; i++) {
-	if (!Test(i)) {
-	    Mark(i);
-	    return i;
-	}
-    }
-    return -1;
+    int which = NextClear(0);
+
+    if (which != -1)
+	Mark(which);
+    return which;
 }
 
 //----------------------------------------------------------------------
@@ -128,14 +210,198 @@ Bitmap::FindAndSet()
 int 
 Bitmap::NumClear() const
 {
-    int count = 0;
+    return numClear;
+}
 
-    for (int i = 0; i < numBits; i++) {
-	if (!Test(i)) {
-	    count++;
+//----------------------------------------------------------------------
+// Bitmap::WordClear
+// 	Return the number of clear bits in one word of the bitmap (the
+//	bits past numBits, which are kept set, do not count).
+//
+//	"word" is the index of the word in "map".
+//----------------------------------------------------------------------
+
+int
+Bitmap::WordClear(int word) const
+{
+    return BitsInWord - CountBits(map[word]);
+}
+
+//----------------------------------------------------------------------
+// Bitmap::NextClear
+// 	Return the number of the first clear bit at or after "which",
+//	or -1 if there is none.  Full words are skipped by looking at
+//	the summary.
+//----------------------------------------------------------------------
+
+int
+Bitmap::NextClear(int which) const
+{
+    int word = which / BitsInWord;
+    BitWord bits;
+
+    if (which >= numBits)
+	return -1;
+    bits = ~map[word] & BitsFrom(which % BitsInWord);
+    if (bits != 0)
+	return word * BitsInWord + LowestBit(bits);
+
+    // find the next word with a clear bit in the summary
+    word++;
+    for (int s = word / BitsInWord; s < numSummaryWords; s++) {
+	bits = summary[s];
+	if (s == word / BitsInWord)
+	    bits &= BitsFrom(word % BitsInWord);
+	if (bits != 0) {
+	    word = s * BitsInWord + LowestBit(bits);
+	    return word * BitsInWord + LowestBit(~map[word]);
 	}
     }
-    return count;
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// Bitmap::NextSet
+// 	Return the number of the first set bit at or after "which", or
+//	numBits if there is none.
+//----------------------------------------------------------------------
+
+int
+Bitmap::NextSet(int which) const
+{
+    int word = which / BitsInWord;
+    BitWord bits;
+
+    if (which >= numBits)
+	return numBits;
+    bits = map[word] & BitsFrom(which % BitsInWord);
+    while (bits == 0) {
+	if (++word == numWords)
+	    return numBits;
+	bits = map[word];
+    }
+    return min(word * BitsInWord + LowestBit(bits), numBits);
+}
+
+//----------------------------------------------------------------------
+// Bitmap::FindRun
+// 	Look for a run of "count" consecutive clear bits, without setting
+//	them.  Return the number of the first bit of the run, and set
+//	"*length" to the number of bits found.
+//
+//	If "hint" is clear (typically, the bit right after the last
+//	sector of a file), we return the run starting there, even if it
+//	is short, so the caller can extend what it already has.
+//	Otherwise, with a hint we take the first run that is big enough
+//	from the hint on (next fit), and without one (hint < 0) the
+//	smallest run that is big enough (best fit), so large holes stay
+//	available for large files.
+//
+//	If no run is long enough, return the longest one; if no bits
+//	are clear, return -1.
+//
+//	"count" is the number of bits wanted
+//	"hint" is where to start looking, or -1
+//	"length" is set to the number of bits found
+//----------------------------------------------------------------------
+
+int
+Bitmap::FindRun(int count, int hint, int *length) const
+{
+    int bestStart = -1, bestLength = 0;	// smallest run that is big enough
+    int bigStart = -1, bigLength = 0;	// largest run, if none is
+    int i, len, end;
+
+    ASSERT(count > 0);
+    if (hint >= numBits)
+	hint = -1;
+    if (hint >= 0 && !Test(hint)) {
+	*length = RunLength(hint, count);
+	return hint;
+    }
+
+    // look from the hint to the end, then wrap around up to the hint
+    i = max(hint, 0);
+    end = numBits;
+    for (;;) {
+	i = NextClear(i);
+	if (i == -1 || i >= end) {
+	    if (end == numBits && hint > 0) {
+		i = 0;			// wrap around
+		end = hint;
+		continue;
+	    }
+	    break;
+	}
+	len = RunLength(i, end - i);
+	if (len >= count) {
+	    if (hint >= 0) {			// next fit
+		*length = count;
+		return i;
+	    }
+	    if (bestStart == -1 || len < bestLength) {
+		bestStart = i;
+		bestLength = len;
+		if (len == count)
+		    break;			// can't do better
+	    }
+	} else if (len > bigLength) {
+	    bigStart = i;
+	    bigLength = len;
+	}
+	i += len;
+    }
+    if (bestStart != -1) {
+	*length = count;
+	return bestStart;
+    }
+    *length = bigLength;
+    return bigStart;
+}
+
+//----------------------------------------------------------------------
+// Bitmap::FindAndSetRun
+// 	Find a run of clear bits as in FindRun, and set them (allocate
+//	them).  Return the first bit of the run, or -1 if no bits are
+//	clear.
+//
+//	"count" is the number of bits wanted
+//	"hint" is where to start looking, or -1
+//	"length" is set to the number of bits allocated
+//----------------------------------------------------------------------
+
+int
+Bitmap::FindAndSetRun(int count, int hint, int *length)
+{
+    int start = FindRun(count, hint, length);
+
+    for (int i = 0; i < *length; i++)
+	Mark(start + i);
+    return start;
+}
+
+//----------------------------------------------------------------------
+// Bitmap::RunLength
+// 	Return the number of consecutive clear bits starting at "which",
+//	counting no further than "limit" bits.
+//----------------------------------------------------------------------
+
+int
+Bitmap::RunLength(int which, int limit) const
+{
+    int end = min(which + limit, numBits);
+    int word = which / BitsInWord;
+    BitWord bits;
+
+    if (which >= end)
+	return 0;
+    bits = map[word] & BitsFrom(which % BitsInWord);
+    while (bits == 0) {			// look no further than "end"
+	if (++word * BitsInWord >= end)
+	    return end - which;
+	bits = map[word];
+    }
+    return min(word * BitsInWord + LowestBit(bits), end) - which;
 }
 
 //----------------------------------------------------------------------
@@ -150,10 +416,8 @@ void
 Bitmap::Print() const
 {
     cout << "Bitmap set:\n"; 
-    for (int i = 0; i < numBits; i++) {
-	if (Test(i)) {
-	    cout << i << ", ";
-	}
+    for (int i = NextSet(0); i < numBits; i = NextSet(i + 1)) {
+	cout << i << ", ";
     }
     cout << "\n"; 
 }
@@ -188,4 +452,25 @@ Bitmap::SelfTest()
     for (i = 0; i < numBits; i++) {
         Clear(i);
     }
+
+    int length;
+    Mark(4);				// runs: 0-3, 5-9, 11-...
+    Mark(10);
+    ASSERT(FindAndSetRun(3, -1, &length) == 0 && length == 3);	// best fit
+    ASSERT(FindAndSetRun(5, -1, &length) == 5 && length == 5);
+    ASSERT(FindAndSetRun(2, 3, &length) == 3 && length == 1);	// extend
+    ASSERT(FindRun(numBits, 0, &length) == 11 && length == numBits - 11);
+    for (i = 0; i < numBits; i++) {
+        Clear(i);
+    }
+
+    for (i = 0; i < numBits; i++) {	// a clear bit past a full word
+        Mark(i);
+    }
+    Clear(numBits - 1);
+    ASSERT(NumClear() == 1 && FindAndSet() == numBits - 1);
+    for (i = 0; i < numBits; i++) {
+        Clear(i);
+    }
+    ASSERT(NumClear() == numBits);
 }
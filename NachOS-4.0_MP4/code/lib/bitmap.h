@@ -2,8 +2,12 @@
 //	Data structures defining a bitmap -- an array of bits each of which
 //	can be either on or off.
 //
-//	Represented as an array of unsigned integers, on which we do
-//	modulo arithmetic to find the bit we are interested in.
+//	Represented as an array of 64-bit words, on which we do
+//	modulo arithmetic to find the bit we are interested in.  Searches
+//	look at a whole word at a time, and a summary bitmap -- one bit
+//	per word, set if the word has any clear bit -- lets them skip
+//	over full words without looking at them.  The number of clear
+//	bits is kept up to date as bits are set and cleared.
 //
 //	The bitmap can be parameterized with with the number of bits being 
 //	managed.
@@ -18,9 +22,10 @@
 #include "copyright.h"
 #include "utility.h"
 
-// Definitions helpful for representing a bitmap as an array of integers
+// Definitions helpful for representing a bitmap as an array of words
+typedef unsigned long long BitWord;
 const int BitsInByte =	8;
-const int BitsInWord = sizeof(unsigned int) * BitsInByte;
+const int BitsInWord = sizeof(BitWord) * BitsInByte;
 
 // The following class defines a "bitmap" -- an array of bits,
 // each of which can be independently set, cleared, and tested.
@@ -34,16 +39,24 @@ class Bitmap {
   public:
     Bitmap(int numItems);	// Initialize a bitmap, with "numItems" bits
 				// initially, all bits are cleared.
-    ~Bitmap();			// De-allocate bitmap
+    virtual ~Bitmap();		// De-allocate bitmap
     
-    void Mark(int which);   	// Set the "nth" bit
-    void Clear(int which);  	// Clear the "nth" bit
+    virtual void Mark(int which);	// Set the "nth" bit
+    virtual void Clear(int which);	// Clear the "nth" bit
     bool Test(int which) const;	// Is the "nth" bit set?
     int FindAndSet();         // Return the # of a clear bit, and as a side
 				// effect, set the bit. 
 				// If no bits are clear, return -1.
     int NumClear() const;	// Return the number of clear bits
 
+    int FindRun(int count, int hint, int *length) const;
+				// Return the first bit of a run of
+				// "count" clear bits (or of the longest
+				// run, if none is that long), and set
+				// "*length" to the length found
+    int FindAndSetRun(int count, int hint, int *length);
+				// Same, but also set the bits of the run
+
     void Print() const;		// Print contents of bitmap
     void SelfTest();		// Test whether bitmap is working
     
@@ -53,7 +66,27 @@ class Bitmap {
 				// (rounded up if numBits is not a
 				//  multiple of the number of bits in
 				//  a word)
-    unsigned int *map;		// bit storage
+    BitWord *map;		// bit storage
+
+    void Rebuild();		// Recompute the summary and the count of
+				// clear bits, after "map" was overwritten
+    int WordClear(int word) const;	// Number of clear bits in a word
+				// of "map"
+
+  private:
+    int numClear;		// number of clear bits
+    int numSummaryWords;	// words of summary storage
+    BitWord *summary;		// bit "i" is set if map[i] has a clear bit
+
+    void UpdateSummary(int word);	// Bring the summary bit for a word
+				// up to date
+    int NextClear(int which) const;	// First clear bit at or after
+				// "which", or -1
+    int NextSet(int which) const;	// First set bit at or after
+				// "which", or numBits
+    int RunLength(int which, int limit) const;
+				// Number of clear bits starting at
+				// "which", up to "limit"
 };
 
 #endif // BITMAP_H
@@ -1,6 +1,7 @@
 // libtest.cc 
 //	Driver code to call self-test routines for standard library
-//	classes -- bitmaps, lists, sorted lists, and hash tables.
+//	classes -- bitmaps, lists, sorted lists, and hash tables --
+//	and a micro-benchmark of bitmap searches.
 //
 // Copyright (c) 1992-1996 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -12,6 +13,7 @@
 #include "list.h"
 #include "hash.h"
 #include "sysdep.h"
+#include <time.h>
 
 //----------------------------------------------------------------------
 // IntCompare
@@ -58,10 +60,72 @@ static int listTestVector[] = { 9, 5, 7 };
 static char *hashTestVector[] = { "0", "1", "2", "3", "4", "5", "6",
 	 "7", "8", "9", "10", "11", "12", "13", "14"};
 
+//----------------------------------------------------------------------
+// NsPerOp
+//	Return the host time per operation, in nanoseconds, for "ops"
+//	operations started at "start".
+//----------------------------------------------------------------------
+
+static double
+NsPerOp(clock_t start, int ops)
+{
+    return (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / ops;
+}
+
+//----------------------------------------------------------------------
+// BitmapBenchmark
+//	Time the bitmap operations the file system depends on, on a
+//	bitmap as big as the free sector map, and compare with searching
+//	one bit at a time (the way FindAndSet used to work).
+//----------------------------------------------------------------------
+
+static void
+BitmapBenchmark()
+{
+    const int numBits = 524288;		// one bit per disk sector
+    const int numOps = 10000;
+    const int numScans = 20;
+    Bitmap *map = new Bitmap(numBits);
+    clock_t start;
+    double fill, find, count, scan;
+    int i, j;
+
+    start = clock();				// allocate every bit in turn
+    for (i = 0; i < numBits; i++)
+	map->FindAndSet();
+    fill = NsPerOp(start, numBits);
+
+    start = clock();				// only the last bits are free
+    for (i = 0; i < numOps; i++) {
+	map->Clear(numBits - 1 - i % BitsInWord);
+	map->FindAndSet();
+    }
+    find = NsPerOp(start, numOps);
+
+    start = clock();
+    for (i = 0; i < numOps; i++)
+	map->NumClear();
+    count = NsPerOp(start, numOps);
+
+    map->Clear(numBits - 1);
+    start = clock();				// the same search, bit by bit
+    for (i = 0; i < numScans; i++) {
+	for (j = 0; map->Test(j); j++)
+	    ;
+    }
+    scan = NsPerOp(start, numScans);
+
+    cout << "Bitmap of " << numBits << " bits, ns per operation: "
+	<< "fill " << fill << ", find last " << find
+	<< ", count " << count << " (bit by bit: find last " << scan
+	<< ")\n";
+    delete map;
+}
+
 //----------------------------------------------------------------------
 // LibSelfTest
 //	Run self tests on bitmaps, lists, sorted lists, and 
-//	hash tables.
+//	hash tables, then time the bitmap.
 //----------------------------------------------------------------------
 
 void
@@ -77,6 +141,7 @@ LibSelfTest () {
     list->SelfTest(listTestVector, sizeof(listTestVector)/sizeof(int));
     sortList->SelfTest(listTestVector, sizeof(listTestVector)/sizeof(int));
     hashTable->SelfTest(hashTestVector, sizeof(hashTestVector)/sizeof(char *));
+    BitmapBenchmark();
 
     delete map;
     delete list;
@@ -32,7 +32,8 @@ const int DiskSize = (MagicSize + (NumSectors * SectorSize));
 // Disk::Disk()
 // 	Initialize a simulated disk.  Open the UNIX file (creating it
 //	if it doesn't exist), and check the magic number to make sure it's 
-// 	ok to treat it as Nachos disk storage.
+// 	ok to treat it as Nachos disk storage.  If asked to (-md), map
+//	the file into memory.
 //
 //	"toCall" -- object to call when disk read/write request completes
 //----------------------------------------------------------------------
@@ -60,17 +61,28 @@ Disk::Disk(CallBackObj *toCall)
         Lseek(fileno, DiskSize - sizeof(int), 0);	
 	WriteFile(fileno, (char *)&tmp, sizeof(int));  
     }
+    image = NULL;
+    if (kernel->mapDisk) {
+	image = MapFile(fileno, DiskSize);
+	if (image == NULL) {
+	    DEBUG(dbgDisk, "Cannot map the disk; using reads and writes.");
+	}
+    }
     active = FALSE;
 }
 
 //----------------------------------------------------------------------
 // Disk::~Disk()
 // 	Clean up disk simulation, by closing the UNIX file representing the
-//	disk.
+//	disk (writing it back first, if it is mapped).
 //----------------------------------------------------------------------
 
 Disk::~Disk()
 {
+    if (image != NULL) {
+	SyncMappedFile(image, DiskSize);
+	UnmapFile(image, DiskSize);
+    }
     Close(fileno);
 }
 
@@ -111,44 +123,103 @@ PrintSector (bool writing, int sector, char *data)
 
 void
 Disk::ReadRequest(int sectorNumber, char* data)
+{
+    ReadRequest(sectorNumber, &data, 1);
+}
+
+void
+Disk::WriteRequest(int sectorNumber, char* data)
+{
+    WriteRequest(sectorNumber, &data, 1);
+}
+
+//----------------------------------------------------------------------
+// Disk::ReadRequest/WriteRequest
+// 	Simulate a request to read/write a run of consecutive disk
+//	sectors, as for a single sector.  Each sector has its own buffer,
+//	so the run can be gathered from, or scattered to, anywhere in
+//	memory.  The latency of the whole run is computed up front, and
+//	there is one interrupt, when the last sector is done.
+//
+//	"sectorNumber" -- the first disk sector to read/write
+//	"data" -- the buffers to write from, or read into, one per sector
+//	"count" -- the number of sectors in the run
+//----------------------------------------------------------------------
+
+void
+Disk::ReadRequest(int sectorNumber, char** data, int count)
 {
     int ticks = ComputeLatency(sectorNumber, FALSE);
 
     ASSERT(!active);				// only one request at a time
-    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+    ASSERT((sectorNumber >= 0) && (count > 0)
+		&& (sectorNumber + count <= NumSectors));
     
-    DEBUG(dbgDisk, "Reading from sector " << sectorNumber);
-    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
-    Read(fileno, data, SectorSize);
-    if (debug->IsEnabled('d'))
-	PrintSector(FALSE, sectorNumber, data);
+    DEBUG(dbgDisk, "Reading " << count << " sectors from sector " << sectorNumber);
+    if (image == NULL)
+	Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
+    for (int i = 0; i < count; i++) {
+	if (image != NULL)
+	    bcopy(&image[SectorSize * (sectorNumber + i) + MagicSize],
+						data[i], SectorSize);
+	else
+	    Read(fileno, data[i], SectorSize);
+	if (debug->IsEnabled('d'))
+	    PrintSector(FALSE, sectorNumber + i, data[i]);
+    }
     
     active = TRUE;
     UpdateLast(sectorNumber);
-    kernel->stats->numDiskReads++;
+    ticks += RestOfRun(sectorNumber, count, ticks);
+    kernel->stats->numDiskReads += count;
+    kernel->stats->numDiskRequests++;
     kernel->interrupt->Schedule(this, ticks, DiskInt);
 }
 
 void
-Disk::WriteRequest(int sectorNumber, char* data)
+Disk::WriteRequest(int sectorNumber, char** data, int count)
 {
     int ticks = ComputeLatency(sectorNumber, TRUE);
 
     ASSERT(!active);
-    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+    ASSERT((sectorNumber >= 0) && (count > 0)
+		&& (sectorNumber + count <= NumSectors));
     
-    DEBUG(dbgDisk, "Writing to sector " << sectorNumber);
-    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
-    WriteFile(fileno, data, SectorSize);
-    if (debug->IsEnabled('d'))
-	PrintSector(TRUE, sectorNumber, data);
+    DEBUG(dbgDisk, "Writing " << count << " sectors to sector " << sectorNumber);
+    if (image == NULL)
+	Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
+    for (int i = 0; i < count; i++) {
+	if (image != NULL)
+	    bcopy(data[i], &image[SectorSize * (sectorNumber + i) + MagicSize],
+								SectorSize);
+	else
+	    WriteFile(fileno, data[i], SectorSize);
+	if (debug->IsEnabled('d'))
+	    PrintSector(TRUE, sectorNumber + i, data[i]);
+    }
     
     active = TRUE;
     UpdateLast(sectorNumber);
-    kernel->stats->numDiskWrites++;
+    ticks += RestOfRun(sectorNumber, count, ticks);
+    kernel->stats->numDiskWrites += count;
+    kernel->stats->numDiskRequests++;
     kernel->interrupt->Schedule(this, ticks, DiskInt);
 }
 
+//----------------------------------------------------------------------
+// Disk::Sync
+// 	Make sure every sector written so far has reached the UNIX file.
+//	Writes go straight to the file unless it is mapped into memory,
+//	in which case the changed pages are written back now.
+//----------------------------------------------------------------------
+
+void
+Disk::Sync()
+{
+    if (image != NULL)
+	SyncMappedFile(image, DiskSize);
+}
+
 //----------------------------------------------------------------------
 // Disk::CallBack()
 // 	Called by the machine simulation when the disk interrupt occurs.
@@ -265,3 +336,42 @@ Disk::UpdateLast(int newSector)
     lastSector = newSector;
     DEBUG(dbgDisk, "Updating last sector = " << lastSector << " , " << bufferInit);
 }
+
+//----------------------------------------------------------------------
+// Disk::RestOfRun
+//   	Return how much longer a run of sectors takes after its first
+//	sector, which is done "ticks" from now.  Each following sector on
+//	the same track is already under the head, and takes just the time
+//	to transfer it.  When the run reaches the end of a track, the head
+//	steps to the next one and waits for its first sector to come
+//	around; the track buffer starts over there.
+//
+//	Leaves the last sector of the run as the most recently requested.
+//
+//	"first" -- the first sector of the run
+//	"count" -- the number of sectors in the run
+//	"ticks" -- the latency of the first sector
+//----------------------------------------------------------------------
+
+int
+Disk::RestOfRun(int first, int count, int ticks)
+{
+    int now = kernel->stats->totalTicks;
+    int done = now + ticks;		// when the previous sector is done
+
+    for (int sector = first + 1; sector < first + count; sector++) {
+	if (sector % SectorsPerTrack == 0) {	// step to the next track
+	    int over;
+
+	    done += SeekTime;
+	    over = done % RotationTime;
+	    if (over > 0)
+		done += RotationTime - over;
+	    bufferInit = done;
+	    done += ModuloDiff(sector, done / RotationTime) * RotationTime;
+	}
+	done += RotationTime;
+    }
+    lastSector = first + count - 1;
+    return done - now - ticks;
+}
@@ -34,6 +34,9 @@
 // and an interrupt is invoked later to signal that the operation completed.
 //
 // The physical disk is in fact simulated via operations on a UNIX file.
+// Optionally (-md), the file is mapped into memory, and sectors are
+// simply copied to and from the mapping; this only saves host system
+// calls, and does not change the simulated time of any request.
 //
 // To make life a little more realistic, the simulated time for
 // each operation reflects a "track buffer" -- RAM to store the contents
@@ -46,6 +49,11 @@
 // disks these days now come with a track buffer.
 //
 // The track buffer simulation can be disabled by compiling with -DNOTRACKBUF
+//
+// A request can also cover a run of consecutive sectors.  The head
+// seeks to the first one, and then the rest pass under it one after
+// another (stepping to the next track when the run crosses one), so
+// large transfers pay for positioning the head only once.
 
 const int SectorSize = 128;		// number of bytes per disk sector
 const int SectorsPerTrack  = 512;	// number of sectors per disk track 
@@ -67,9 +75,21 @@ class Disk : public CallBackObj {
     					// Only one request allowed at a time!
     void WriteRequest(int sectorNumber, char* data);
 
+    void ReadRequest(int sectorNumber, char** data, int count);
+    void WriteRequest(int sectorNumber, char** data, int count);
+					// Read/write a run of "count"
+					// consecutive sectors, starting at
+					// sectorNumber, into/from one buffer
+					// per sector ("scatter/gather").
+					// The run costs one seek and one
+					// interrupt, not one per sector.
+
     void CallBack();			// Invoked when disk request 
 					// finishes. In turn calls, callWhenDone.
 
+    void Sync();			// Make sure everything written has
+					// reached the disk's UNIX file
+
     int ComputeLatency(int newSector, bool writing);	
     					// Return how long a request to 
 					// newSector will take: 
@@ -78,6 +98,8 @@ class Disk : public CallBackObj {
   private:
     int fileno;				// UNIX file number for simulated disk 
     char diskname[32];			// name of simulated disk's file
+    char *image;			// the file mapped into memory, or
+					// NULL if it is not mapped
     CallBackObj *callWhenDone;		// Invoke when any disk request finishes
     bool active;     			// Is a disk operation in progress?
     int lastSector;			// The previous disk request 
@@ -87,6 +109,9 @@ class Disk : public CallBackObj {
     int TimeToSeek(int newSector, int *rotate); // time to get to the new track
     int ModuloDiff(int to, int from);        // # sectors between to and from
     void UpdateLast(int newSector);
+    int RestOfRun(int first, int count, int ticks);
+					// time to transfer the rest of a run,
+					// after its first sector
 };
 
 #endif // DISK_H
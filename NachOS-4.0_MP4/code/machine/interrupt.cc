@@ -242,8 +242,8 @@ Interrupt::Halt()
     cout << "This is halt\n";
     kernel->stats->Print();
 	*/
-	delete debug;
-	
+    if (kernel->printStats)		// only if asked for, with -S
+	kernel->stats->Print();
     delete kernel;	// Never returns.
 }
 
@@ -298,6 +298,36 @@ Interrupt::CloseFileId(int ID)
 	return kernel->CloseFileId(ID);
 }
 
+int
+Interrupt::SeekFileId(int position, int ID)
+{
+	return kernel->SeekFileId(position, ID);
+}
+
+int
+Interrupt::PReadFromFileId(char *buffer, int size, int position, int ID)
+{
+	return kernel->PReadFromFileId(buffer, size, position, ID);
+}
+
+int
+Interrupt::PWriteToFileId(char *buffer, int size, int position, int ID)
+{
+	return kernel->PWriteToFileId(buffer, size, position, ID);
+}
+
+int
+Interrupt::FsyncFileId(int ID)
+{
+	return kernel->FsyncFileId(ID);
+}
+
+void
+Interrupt::SyncFileSystem()
+{
+	kernel->SyncFileSystem();
+}
+
 //----------------------------------------------------------------------
 // Interrupt::Schedule
 // 	Arrange for the CPU to be interrupted when simulated time
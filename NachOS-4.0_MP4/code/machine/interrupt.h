@@ -119,6 +119,11 @@ class Interrupt {
 	int WriteToFileId(char *buffer, int size, int ID);
 	int ReadFromFileId(char *buffer, int size, int ID);
 	int CloseFileId(int ID);
+	int SeekFileId(int position, int ID);
+	int PReadFromFileId(char *buffer, int size, int position, int ID);
+	int PWriteToFileId(char *buffer, int size, int position, int ID);
+	int FsyncFileId(int ID);
+	void SyncFileSystem();
 	//
     // NOTE: the following are internal to the hardware simulation code.
     // DO NOT call these directly.  I should make them "private",
@@ -19,9 +19,19 @@
 Statistics::Statistics()
 {
     totalTicks = idleTicks = systemTicks = userTicks = 0;
-    numDiskReads = numDiskWrites = 0;
+    numDiskReads = numDiskWrites = numDiskRequests = 0;
+    numDiskQueued = maxDiskQueue = numDiskSeekTracks = 0;
+    numCacheHits = numCacheMisses = numCacheEvictions = 0;
+    numReadAheads = 0;
+    numDentryHits = numDentryMisses = 0;
+    numJournalCommits = numJournalSectors = numJournalCheckpoints = 0;
+    numWritesBuffered = numWriteFlushes = numFlusherRuns = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
     numPageFaults = numPacketsSent = numPacketsRecvd = 0;
+    for (int i = 0; i < NumSyscallCodes; i++) {
+	numSyscalls[i] = syscallTicks[i] = 0;
+	syscallNames[i] = NULL;
+    }
 }
 
 //----------------------------------------------------------------------
@@ -37,9 +47,32 @@ Statistics::Print()
 		cout << ", system " << systemTicks << ", user " << userTicks <<"\n";
     cout << "Disk I/O: reads " << numDiskReads;
 		cout << ", writes " << numDiskWrites << "\n";
+    int requests = max(numDiskRequests, 1);
+    cout << "Disk queue: requests " << numDiskRequests;
+		cout << ", average depth "
+		<< (double) numDiskQueued / requests;
+		cout << ", max depth " << maxDiskQueue;
+		cout << ", average seek "
+		<< (double) numDiskSeekTracks / requests << " tracks\n";
+    cout << "Sector cache: hits " << numCacheHits;
+		cout << ", misses " << numCacheMisses;
+		cout << ", evictions " << numCacheEvictions;
+		cout << ", read ahead " << numReadAheads << "\n";
+    cout << "Path cache: hits " << numDentryHits;
+		cout << ", misses " << numDentryMisses << "\n";
+    cout << "Journal: commits " << numJournalCommits;
+		cout << ", sectors logged " << numJournalSectors;
+		cout << ", checkpoints " << numJournalCheckpoints << "\n";
+    cout << "Write behind: writes buffered " << numWritesBuffered;
+		cout << ", flushes " << numWriteFlushes;
+		cout << ", flusher runs " << numFlusherRuns << "\n";
 		cout << "Console I/O: reads " << numConsoleCharsRead;
     cout << ", writes " << numConsoleCharsWritten << "\n";
     cout << "Paging: faults " << numPageFaults << "\n";
     cout << "Network I/O: packets received " << numPacketsRecvd;
 		cout << ", sent " << numPacketsSent << "\n";
+    for (int i = 0; i < NumSyscallCodes; i++)
+	if (numSyscalls[i] > 0)
+	    cout << "System call " << syscallNames[i] << ": calls "
+		<< numSyscalls[i] << ", ticks " << syscallTicks[i] << "\n";
 }
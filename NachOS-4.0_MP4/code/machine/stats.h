@@ -13,6 +13,9 @@
 
 #include "copyright.h"
 
+#define NumSyscallCodes	101	// system call codes run from SC_Halt (0)
+				// to SC_MSG (100); see userprog/syscall.h
+
 // The following class defines the statistics that are to be kept
 // about Nachos behavior -- how much time (ticks) elapsed, how
 // many user instructions executed, etc.
@@ -28,13 +31,38 @@ class Statistics {
 				// (this is also equal to # of
 				// user instructions executed)
 
-    int numDiskReads;		// number of disk read requests
-    int numDiskWrites;		// number of disk write requests
+    int numDiskReads;		// number of disk sectors read
+    int numDiskWrites;		// number of disk sectors written
+    int numDiskRequests;	// number of requests (runs of sectors)
+				// sent to the disk
+    int numDiskQueued;		// requests found waiting for the disk,
+				// summed over every request that waited
+    int maxDiskQueue;		// most requests ever waiting for the disk
+    int numDiskSeekTracks;	// number of tracks the disk head moved
+    int numCacheHits;		// number of sector cache hits
+    int numCacheMisses;		// number of sector cache misses, not
+				// counting sectors read ahead
+    int numCacheEvictions;	// number of sectors replaced in the cache
+    int numReadAheads;		// number of sectors read ahead of time
+    int numDentryHits;		// number of path lookups found in the cache
+    int numDentryMisses;	// number of path lookups that read a directory
+    int numJournalCommits;	// number of transactions committed
+    int numJournalSectors;	// number of sectors written to the log
+    int numJournalCheckpoints;	// number of times the log was emptied
+    int numWritesBuffered;	// number of writes held in a file's
+				// write-behind buffer
+    int numWriteFlushes;	// number of write-behind buffers written
+    int numFlusherRuns;		// number of times the flusher woke up
     int numConsoleCharsRead;	// number of characters read from the keyboard
     int numConsoleCharsWritten; // number of characters written to the display
     int numPageFaults;		// number of virtual memory page faults
     int numPacketsSent;		// number of packets sent over the network
     int numPacketsRecvd;	// number of packets received over the network
+    int numSyscalls[NumSyscallCodes];	// number of times each system
+				// call was made, by code
+    int syscallTicks[NumSyscallCodes];	// ticks spent in each, waiting
+				// for the disk included
+    const char *syscallNames[NumSyscallCodes];	// their names, for Print
 
     Statistics(); 		// initialize everything to zero
 
@@ -0,0 +1,5 @@
+../build.linux/nachos -f
+../build.linux/nachos -cp num_1000000.txt /bonusI
+../build.linux/nachos -cp readbench /readbench
+echo "========================================"
+../build.linux/nachos -S -e /readbench | grep -v "^--Read in exec"
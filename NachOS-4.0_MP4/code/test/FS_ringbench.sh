@@ -0,0 +1,7 @@
+../build.linux/nachos -f
+../build.linux/nachos -cp trapbench /trapbench
+../build.linux/nachos -cp ringbench /ringbench
+echo "======================================== one Write per record"
+../build.linux/nachos -S -e /trapbench | grep -v "^--"
+echo "======================================== RingEnter per 16 records"
+../build.linux/nachos -S -e /ringbench | grep -v "^--"
@@ -0,0 +1,26 @@
+/* readbench.c
+ *	Benchmark for sequential file reading: read num_1000000.txt
+ *	(copied into the Nachos file system as /bonusI) one byte at a
+ *	time, and count its lines.
+ *
+ *	Run with -S to see how many simulated ticks it took; see
+ *	FS_readbench.sh.
+ */
+
+#include "syscall.h"
+
+int main(void)
+{
+	char c;
+	int lines = 0;
+	OpenFileId fid;
+
+	fid = Open("/bonusI");
+	if (fid <= 0) MSG("Failed on opening file");
+	while (Read(&c, 1, fid) == 1)
+		if (c == '\n') lines++;
+	if (Close(fid) != 1) MSG("Failed on closing file");
+	if (lines != 100000) MSG("Failed: wrong number of lines");
+	MSG("Passed! ^_^");
+	Halt();
+}
@@ -0,0 +1,67 @@
+/* ringbench.c
+ *	Benchmark for the system call ring: write a short record to a
+ *	file NumRecords times, with one Write system call per record, or
+ *	(built with -DRING, as ringbench) RingEntries records per
+ *	RingEnter.  Built without it, this is trapbench.
+ *
+ *	Run with -S to see how many simulated ticks each took; see
+ *	FS_ringbench.sh.
+ */
+
+#include "syscall.h"
+
+#define NumRecords	1024
+#define RecordSize	8
+
+char record[] = "abcdefg\n";
+
+#ifdef RING
+IoRing ring;
+
+int main(void)
+{
+	OpenFileId fid;
+	RingRequest *request;
+	int i, n;
+
+	if (Create("/ring.out", 0) != 1) MSG("Failed on creating file");
+	fid = Open("/ring.out");
+	if (fid <= 0) MSG("Failed on opening file");
+	if (RingSetup(&ring) != 1) MSG("Failed on setting up the ring");
+	for (i = 0; i < NumRecords; i += RingEntries) {
+		for (n = 0; n < RingEntries; n++) {
+			request = &ring.requests[ring.requestTail % RingEntries];
+			request->opcode = RingWrite;
+			request->fd = fid;
+			request->buffer = record;
+			request->size = RecordSize;
+			request->data = i + n;
+			ring.requestTail++;
+		}
+		if (RingEnter() != RingEntries) MSG("Failed on entering the ring");
+		for (; ring.completionHead != ring.completionTail; ring.completionHead++)
+			if (ring.completions[ring.completionHead % RingEntries].result
+							!= RecordSize)
+				MSG("Failed on writing file");
+	}
+	if (Close(fid) != 1) MSG("Failed on closing file");
+	MSG("Passed! ^_^");
+	Halt();
+}
+#else
+int main(void)
+{
+	OpenFileId fid;
+	int i;
+
+	if (Create("/trap.out", 0) != 1) MSG("Failed on creating file");
+	fid = Open("/trap.out");
+	if (fid <= 0) MSG("Failed on opening file");
+	for (i = 0; i < NumRecords; i++)
+		if (Write(record, RecordSize, fid) != RecordSize)
+			MSG("Failed on writing file");
+	if (Close(fid) != 1) MSG("Failed on closing file");
+	MSG("Passed! ^_^");
+	Halt();
+}
+#endif
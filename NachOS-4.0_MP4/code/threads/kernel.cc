@@ -15,6 +15,11 @@
 #include "libtest.h"
 #include "string.h"
 #include "synchdisk.h"
+#include "sectorcache.h"
+#include "inodetable.h"
+#include "dentrycache.h"
+#include "journal.h"
+#include "flusher.h"
 #include "post.h"
 #include "synchconsole.h"
 
@@ -30,6 +35,10 @@ Kernel::Kernel(int argc, char **argv)
     debugUserProg = FALSE;
     consoleIn = NULL;          // default is stdin
     consoleOut = NULL;         // default is stdout
+    diskPolicy = NULL;		// default is C-LOOK
+    printStats = FALSE;
+    mapDisk = FALSE;
+    maxOpenFiles = MaxOpenFiles;
 #ifndef FILESYS_STUB
     formatFlag = FALSE;
 #endif
@@ -49,6 +58,8 @@ Kernel::Kernel(int argc, char **argv)
 	    	i++;
         } else if (strcmp(argv[i], "-s") == 0) {
             debugUserProg = TRUE;
+        } else if (strcmp(argv[i], "-S") == 0) {
+            printStats = TRUE;
 		} else if (strcmp(argv[i], "-e") == 0) {
         	execfile[++execfileNum]= argv[++i];
 			cout << execfile[execfileNum] << "\n";
@@ -60,6 +71,17 @@ Kernel::Kernel(int argc, char **argv)
 	    	ASSERT(i + 1 < argc);
 	    	consoleOut = argv[i + 1];
 	    	i++;
+		} else if (strcmp(argv[i], "-dp") == 0) {
+	    	ASSERT(i + 1 < argc);
+	    	diskPolicy = argv[i + 1];
+	    	i++;
+		} else if (strcmp(argv[i], "-md") == 0) {
+	    	mapDisk = TRUE;
+		} else if (strcmp(argv[i], "-fd") == 0) {
+	    	ASSERT(i + 1 < argc);
+	    	maxOpenFiles = atoi(argv[i + 1]);
+	    	ASSERT(maxOpenFiles > 0);
+	    	i++;
 #ifndef FILESYS_STUB
 		} else if (strcmp(argv[i], "-f") == 0) {
 	    	formatFlag = TRUE;
@@ -74,8 +96,9 @@ Kernel::Kernel(int argc, char **argv)
             i++;
         } else if (strcmp(argv[i], "-u") == 0) {
             cout << "Partial usage: nachos [-rs randomSeed]\n";
-	   		cout << "Partial usage: nachos [-s]\n";
+	   		cout << "Partial usage: nachos [-s] [-S]\n";
             cout << "Partial usage: nachos [-ci consoleIn] [-co consoleOut]\n";
+	    	cout << "Partial usage: nachos [-dp fcfs|sstf|scan|clook] [-md] [-fd #]\n";
 #ifndef FILESYS_STUB
 	    	cout << "Partial usage: nachos [-nf]\n";
 #endif
@@ -109,11 +132,18 @@ Kernel::Initialize()
     machine = new Machine(debugUserProg);
     synchConsoleIn = new SynchConsoleInput(consoleIn); // input from stdin
     synchConsoleOut = new SynchConsoleOutput(consoleOut); // output to stdout
-    synchDisk = new SynchDisk();    //
+    synchDisk = new SynchDisk(diskPolicy);
+    sectorCache = new SectorCache(synchDisk);
 #ifdef FILESYS_STUB
     fileSystem = new FileSystem();
 #else
+    flusher = new Flusher();		// told of writes from here on
+    inodeTable = new InodeTable();
+    dentryCache = new DentryCache();
+    journal = new Journal(sectorCache, synchDisk);
     fileSystem = new FileSystem(formatFlag);
+    Thread *t = new Thread("flusher", 1);	// write back now and then
+    t->Fork(Flusher::Run, flusher);
 #endif // FILESYS_STUB
 
 	// MP4 mod tag
@@ -131,12 +161,27 @@ Kernel::Initialize()
 // 	Since Nachos does not disable Timer, Console after all threads complete,
 //	which will result in generating infinite interrupts. We manually disable timer,
 //	console, etc. after all threads complete.
+//
+//	We also use the chance to write back the sector cache: each call
+//	starts writing one dirty sector, and the disk interrupt brings us
+//	back here until all that is left dirty is what the journal has in
+//	its log.  Before that, the journal gets its committer thread to
+//	commit what it has logged, and before that, the flusher thread
+//	writes out the write-behind buffers of files nobody closed; when
+//	the thread is done, we are back here.
 //----------------------------------------------------------------------
 void
 Kernel::PrepareToEnd()
 {
 	alarm->Disable();
 	synchConsoleIn->Disable();
+#ifndef FILESYS_STUB
+	if (flusher->FlushBehind())
+		return;				// so does the flusher
+	if (journal->CommitBehind())
+		return;				// the committer goes first
+#endif
+	sectorCache->FlushBehind();
 }
 
 //----------------------------------------------------------------------
@@ -146,6 +191,15 @@ Kernel::PrepareToEnd()
 
 Kernel::~Kernel()
 {
+    // the file system closes its files through the inode table, which
+    // still needs interrupts (for its lock) and the sector cache
+    delete fileSystem;
+#ifndef FILESYS_STUB
+    delete inodeTable;
+    delete dentryCache;
+    delete journal;
+    delete flusher;
+#endif
     delete stats;
     delete interrupt;
     delete scheduler;
@@ -153,8 +207,8 @@ Kernel::~Kernel()
     delete machine;
     delete synchConsoleIn;
     delete synchConsoleOut;
+    delete sectorCache;
     delete synchDisk;
-    delete fileSystem;
 	
 	// Mp4 mod tag
 	/*
@@ -162,6 +216,7 @@ Kernel::~Kernel()
     delete postOfficeOut;
     */
 	
+    delete debug;	// last, since closing files above still logs
     Exit(0);
 }
 
@@ -343,28 +398,88 @@ int Kernel::CreateFile(char *filename, int size)
 	return fileSystem->Create(filename, size, false);
 }
 
+// File ids are descriptors in the current program's table (see
+// AddrSpace::AddFile); each one reads and writes from its own position.
 int Kernel::Open(char *filename)
 {
-	OPF = fileSystem->Open(filename);
-	if(OPF != NULL) return (int)&OPF;
-	else return -1;
+	OpenFile *file = fileSystem->Open(filename);
+	int ID;
+
+	if(file == NULL) return -1;
+	ID = currentThread->space->AddFile(file);
+	if(ID == -1) delete file;	// too many files open
+	return ID;
 }
 int Kernel::WriteToFileId(char *buffer, int size, int ID)
 {
-	if(ID == (int)&OPF) return OPF->Write(buffer, size);
-	else return -1;
+	FileDescriptor *fd = currentThread->space->GetFile(ID);
+	int result;
+
+	if(fd == NULL) return -1;
+	result = fd->file->WriteAt(buffer, size, fd->position);
+	fd->position += result;
+	return result;
 }
 int Kernel::ReadFromFileId(char *buffer, int size, int ID)
 {
-	if(ID == (int)&OPF) return OPF->Read(buffer, size);
-	else return -1;
+	FileDescriptor *fd = currentThread->space->GetFile(ID);
+	int result;
+
+	if(fd == NULL) return -1;
+	result = fd->file->ReadAt(buffer, size, fd->position);
+	fd->position += result;
+	return result;
 }
+// Close and Fsync report buffered writes that were lost for want of
+// disk space (see OpenFile::Flush); the file is closed all the same.
 int Kernel::CloseFileId(int ID)
 {
-	if(ID == (int)&OPF)
+	FileDescriptor *fd = currentThread->space->GetFile(ID);
+	bool flushed;
+
+	if(fd == NULL) return 0;
+	flushed = fd->file->Flush();
+	currentThread->space->CloseFile(ID);
+	return flushed ? 1 : -1;
+}
+int Kernel::SeekFileId(int position, int ID)
+{
+	FileDescriptor *fd = currentThread->space->GetFile(ID);
+
+	if(fd == NULL || position < 0) return -1;
+	fd->position = position;
+	return position;
+}
+// PRead and PWrite go straight to ReadAt and WriteAt; the descriptor's
+// position is neither used nor moved.
+int Kernel::PReadFromFileId(char *buffer, int size, int position, int ID)
+{
+	FileDescriptor *fd = currentThread->space->GetFile(ID);
+
+	if(fd == NULL || size < 0 || position < 0) return -1;
+	return fd->file->ReadAt(buffer, size, position);
+}
+int Kernel::PWriteToFileId(char *buffer, int size, int position, int ID)
+{
+	FileDescriptor *fd = currentThread->space->GetFile(ID);
+
+	if(fd == NULL || size < 0 || position < 0) return -1;
+	return fd->file->WriteAt(buffer, size, position);
+}
+int Kernel::FsyncFileId(int ID)
+{
+	FileDescriptor *fd = currentThread->space->GetFile(ID);
+
+	if(fd != NULL)
 	{
-		delete OPF;
-		return 1;		
-	}else return 0;
+		bool flushed = fd->file->Flush();	// its write-behind
+		journal->Sync();	// buffer, then everything the cache holds
+		return flushed ? 1 : -1;
+	}else return -1;
+}
+void Kernel::SyncFileSystem()
+{
+	inodeTable->Flush(0);
+	journal->Sync();
 }
 //---------------------------------------------------
@@ -24,6 +24,11 @@ class PostOfficeOutput;
 class SynchConsoleInput;
 class SynchConsoleOutput;
 class SynchDisk;
+class SectorCache;
+class InodeTable;
+class DentryCache;
+class Journal;
+class Flusher;
 
 
 
@@ -56,6 +61,11 @@ class Kernel {
 	int WriteToFileId(char *buffer, int size, int ID);
 	int ReadFromFileId(char *buffer, int size, int ID);
 	int CloseFileId(int ID);
+	int SeekFileId(int position, int ID);
+	int PReadFromFileId(char *buffer, int size, int position, int ID);
+	int PWriteToFileId(char *buffer, int size, int position, int ID);
+	int FsyncFileId(int ID);
+	void SyncFileSystem();
 
 // These are public for notational convenience; really, 
 // they're global variables used everywhere.
@@ -69,11 +79,18 @@ class Kernel {
     SynchConsoleInput *synchConsoleIn;
     SynchConsoleOutput *synchConsoleOut;
     SynchDisk *synchDisk;
+    SectorCache *sectorCache;	// cache of disk sectors, on synchDisk
+    InodeTable *inodeTable;	// headers of open files, shared
+    DentryCache *dentryCache;	// results of recent path lookups
+    Journal *journal;		// log of metadata changes, on sectorCache
+    Flusher *flusher;		// writes back what is held in memory
     FileSystem *fileSystem;     
     PostOfficeInput *postOfficeIn;
     PostOfficeOutput *postOfficeOut;
-	OpenFile *OPF;	
     int hostName;               // machine identifier
+    bool printStats;		// print performance statistics at halt
+    bool mapDisk;		// map the disk's UNIX file into memory
+    int maxOpenFiles;		// files a user program may have open
 
   private:
 
@@ -86,6 +103,7 @@ class Kernel {
     double reliability;         // likelihood messages are dropped
     char *consoleIn;            // file to read console input from
     char *consoleOut;           // file to send console output to
+    char *diskPolicy;		// order to serve disk requests in
 #ifndef FILESYS_STUB
     bool formatFlag;          // format the disk if this is true
 #endif
@@ -79,6 +79,8 @@ class Lock {
     		return lockHolder == kernel->currentThread; }
     				// return true if the current thread 
 				// holds this lock.
+    bool IsHeld() { return lockHolder != NULL; }
+				// return true if any thread holds it
     
     // Note: SelfTest routine provided by SynchList
     
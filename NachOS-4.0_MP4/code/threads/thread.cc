@@ -248,7 +248,9 @@ Thread::Sleep (bool finishing)
     status = BLOCKED;
 	//cout << "debug Thread::Sleep " << name << "wait for Idle\n";
     while ((nextThread = kernel->scheduler->FindNextToRun()) == NULL) {
-		kernel->PrepareToEnd();
+		kernel->PrepareToEnd();		// may wake up a kernel thread
+		if ((nextThread = kernel->scheduler->FindNextToRun()) != NULL)
+			break;
 		kernel->interrupt->Idle();	// no one to run, wait for an interrupt
 	}    
     // returns when it's time for us to run
@@ -79,6 +79,12 @@ AddrSpace::AddrSpace()
     
     // zero out the entire address space
     bzero(kernel->machine->mainMemory, MemorySize);
+
+    numFiles = kernel->maxOpenFiles;
+    files = new FileDescriptor[numFiles];
+    for (int i = 0; i < numFiles; i++)
+	files[i].file = NULL;
+    ring = -1;
 }
 
 //----------------------------------------------------------------------
@@ -88,6 +94,8 @@ AddrSpace::AddrSpace()
 
 AddrSpace::~AddrSpace()
 {
+   CloseFiles();
+   delete [] files;
    delete pageTable;
 }
 
@@ -283,6 +291,10 @@ AddrSpace::Translate(unsigned int vaddr, unsigned int *paddr, int isReadWrite)
 
     pte = &pageTable[vpn];
 
+    if(!pte->valid) {
+        return PageFaultException;
+    }
+
     if(isReadWrite && pte->readOnly) {
         return ReadOnlyException;
     }
@@ -311,6 +323,206 @@ AddrSpace::Translate(unsigned int vaddr, unsigned int *paddr, int isReadWrite)
     return NoException;
 }
 
+//----------------------------------------------------------------------
+// AddrSpace::CheckRange
+// 	Translate each page of "size" bytes of the program's memory, from
+//	"vaddr", and return the first exception found, or NoException if
+//	there is none.  A system call checks a buffer with this before
+//	it does anything it could not take back, such as reading a file.
+//
+//	"vaddr" -- where the range starts, in the program's memory
+//	"size" -- how many bytes it has
+//	"writing" -- TRUE if the kernel is to write into the range
+//----------------------------------------------------------------------
+
+ExceptionType
+AddrSpace::CheckRange(unsigned int vaddr, int size, bool writing)
+{
+    unsigned int paddr;
+    ExceptionType exception;
+    int n;
+
+    for (; size > 0; vaddr += n, size -= n) {
+	n = min(size, (int) (PageSize - vaddr % PageSize));
+	exception = Translate(vaddr, &paddr, writing);
+	if (exception != NoException) {
+	    DEBUG(dbgAddr, "Bad user address " << vaddr);
+	    return exception;
+	}
+    }
+    return NoException;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::CopyIn
+// 	Copy "size" bytes of the program's memory, from "vaddr", into the
+//	kernel's, with one bcopy per page.  Pages need not be consecutive
+//	in physical memory.  Return the exception the program would have
+//	got at the first bad page; what came before it is copied.
+//
+//	"vaddr" -- where to copy from, in the program's memory
+//	"into" -- where to copy to
+//	"size" -- how many bytes to copy
+//----------------------------------------------------------------------
+
+ExceptionType
+AddrSpace::CopyIn(unsigned int vaddr, char *into, int size)
+{
+    unsigned int paddr;
+    ExceptionType exception;
+    int n;
+
+    for (; size > 0; vaddr += n, into += n, size -= n) {
+	n = min(size, (int) (PageSize - vaddr % PageSize));
+	exception = Translate(vaddr, &paddr, FALSE);
+	if (exception != NoException) {
+	    DEBUG(dbgAddr, "Bad user address " << vaddr);
+	    return exception;
+	}
+	bcopy(&kernel->machine->mainMemory[paddr], into, n);
+    }
+    return NoException;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::CopyOut
+// 	Copy "size" bytes of the kernel's memory into the program's, at
+//	"vaddr", with one bcopy per page.  Return the exception the program
+//	would have got at the first bad page; what came before it is copied.
+//
+//	"from" -- where to copy from
+//	"vaddr" -- where to copy to, in the program's memory
+//	"size" -- how many bytes to copy
+//----------------------------------------------------------------------
+
+ExceptionType
+AddrSpace::CopyOut(char *from, unsigned int vaddr, int size)
+{
+    unsigned int paddr;
+    ExceptionType exception;
+    int n;
+
+    for (; size > 0; vaddr += n, from += n, size -= n) {
+	n = min(size, (int) (PageSize - vaddr % PageSize));
+	exception = Translate(vaddr, &paddr, TRUE);
+	if (exception != NoException) {
+	    DEBUG(dbgAddr, "Bad user address " << vaddr);
+	    return exception;
+	}
+	bcopy(from, &kernel->machine->mainMemory[paddr], n);
+    }
+    return NoException;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::CopyInString
+// 	Copy a null-terminated string, such as a file name, from the
+//	program's memory into the kernel's, a page at a time.  A string
+//	that does not end within "max" bytes is as bad as one that runs
+//	off the end of the program's memory: AddressErrorException.
+//
+//	"vaddr" -- where the string starts, in the program's memory
+//	"into" -- where to copy it to; room for "max" bytes
+//	"max" -- the longest string accepted, null included
+//----------------------------------------------------------------------
+
+ExceptionType
+AddrSpace::CopyInString(unsigned int vaddr, char *into, int max)
+{
+    unsigned int paddr;
+    ExceptionType exception;
+    char *from, *end;
+    int n;
+
+    for (; max > 0; vaddr += n, into += n, max -= n) {
+	n = min(max, (int) (PageSize - vaddr % PageSize));
+	exception = Translate(vaddr, &paddr, FALSE);
+	if (exception != NoException) {
+	    DEBUG(dbgAddr, "Bad user address " << vaddr);
+	    return exception;
+	}
+	from = &kernel->machine->mainMemory[paddr];
+	end = (char *) memchr(from, '\0', n);
+	if (end != NULL) {
+	    bcopy(from, into, end - from + 1);
+	    return NoException;
+	}
+	bcopy(from, into, n);
+    }
+    DEBUG(dbgAddr, "User string too long at " << vaddr);
+    return AddressErrorException;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::AddFile
+// 	Give a file the program has just opened the lowest descriptor not
+//	in use, starting at the beginning of the file, and return it.
+//	Return -1, leaving the file to the caller, if the program already
+//	has as many files open as it may.
+//
+//	"file" -- the file opened
+//----------------------------------------------------------------------
+
+int
+AddrSpace::AddFile(OpenFile *file)
+{
+    for (int i = 0; i < numFiles; i++)
+	if (files[i].file == NULL) {
+	    files[i].file = file;
+	    files[i].position = 0;
+	    return i + FirstFileId;
+	}
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::GetFile
+// 	Return the descriptor the program gave as "fd", or NULL if no file
+//	is open with it.
+//
+//	"fd" -- the descriptor, as passed to a system call
+//----------------------------------------------------------------------
+
+FileDescriptor *
+AddrSpace::GetFile(int fd)
+{
+    if (fd < FirstFileId || fd >= FirstFileId + numFiles
+		|| files[fd - FirstFileId].file == NULL)
+	return NULL;
+    return &files[fd - FirstFileId];
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::CloseFile
+// 	Close the file open with descriptor "fd", which is free for the
+//	next file opened.  Return FALSE if no file is open with it.
+//
+//	"fd" -- the descriptor, as passed to a system call
+//----------------------------------------------------------------------
 
+bool
+AddrSpace::CloseFile(int fd)
+{
+    FileDescriptor *descriptor = GetFile(fd);
 
+    if (descriptor == NULL)
+	return FALSE;
+    delete descriptor->file;
+    descriptor->file = NULL;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::CloseFiles
+// 	Close every file the program still has open, when it exits.
+//----------------------------------------------------------------------
 
+void
+AddrSpace::CloseFiles()
+{
+    for (int i = 0; i < numFiles; i++)
+	if (files[i].file != NULL) {
+	    delete files[i].file;
+	    files[i].file = NULL;
+	}
+}
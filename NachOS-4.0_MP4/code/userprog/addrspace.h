@@ -2,9 +2,9 @@
 //	Data structures to keep track of executing user programs 
 //	(address spaces).
 //
-//	For now, we don't keep any information about address spaces.
-//	The user level CPU state is saved and restored in the thread
-//	executing the user program (see thread.h).
+//	Besides its memory, an address space has the files the program
+//	has open.  The user level CPU state is saved and restored in the
+//	thread executing the user program (see thread.h).
 //
 // Copyright (c) 1992-1996 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -17,6 +17,20 @@
 #include "filesys.h"
 
 #define UserStackSize		1024 	// increase this as necessary!
+#define MaxOpenFiles		16	// files a program may have open at
+					// once, unless set with -fd
+#define FirstFileId		2	// 0 and 1 are the console
+
+// The following class defines an open file descriptor: a file a program
+// has opened, and where in it the program's next Read or Write starts.
+// The OpenFile keeps its own position too, but it is not used.
+
+class FileDescriptor {
+  public:
+    OpenFile *file;			// The file; NULL if the descriptor
+					// is not in use
+    int position;			// Where the next Read or Write starts
+};
 
 class AddrSpace {
   public:
@@ -39,6 +53,28 @@ class AddrSpace {
     // is 0 for Read, 1 for Write.
     ExceptionType Translate(unsigned int vaddr, unsigned int *paddr, int mode);
 
+    // Copy between the program's memory and the kernel's, a page at a
+    // time, through Translate.  Return the exception the program would
+    // have got touching the first bad byte, or NoException.
+    ExceptionType CheckRange(unsigned int vaddr, int size, bool writing);
+					// Could all of the range be copied?
+    ExceptionType CopyIn(unsigned int vaddr, char *into, int size);
+    ExceptionType CopyOut(char *from, unsigned int vaddr, int size);
+    ExceptionType CopyInString(unsigned int vaddr, char *into, int max);
+					// A null-terminated string, of at
+					// most "max" bytes with the null
+
+    int AddFile(OpenFile *file);	// Give an open file a descriptor;
+					// -1 if too many files are open
+    FileDescriptor *GetFile(int fd);	// Return the descriptor "fd", or
+					// NULL if no file is open with it
+    bool CloseFile(int fd);		// Close the file open with "fd"
+    void CloseFiles();			// Close every file still open
+
+    void SetRing(int vaddr) { ring = vaddr; }
+    int GetRing() { return ring; }	// Where the program's IoRing is
+					// (see RingSetup), -1 if none
+
   private:
     TranslationEntry *pageTable;	// Assume linear page table translation
 					// for now!
@@ -48,6 +84,11 @@ class AddrSpace {
     void InitRegisters();		// Initialize user-level CPU registers,
 					// before jumping to user code
 
+    FileDescriptor *files;		// Descriptor table, indexed by
+					// fd - FirstFileId
+    int numFiles;			// Size of the table
+    int ring;				// Address of the program's IoRing
+
 };
 
 #endif // ADDRSPACE_H
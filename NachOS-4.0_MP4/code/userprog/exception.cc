@@ -25,6 +25,471 @@
 #include "main.h"
 #include "syscall.h"
 #include "ksyscall.h"
+#include "directory.h"
+
+// Where the parts of an IoRing are in a user program's memory, where a
+// pointer takes a word: four words of heads and tails, then the
+// requests, five words each, then the completions, two words each.
+
+#define RingRequestAt(ring, i)	((ring) + 16 + 20 * ((unsigned) (i) % RingEntries))
+#define RingCompletionAt(ring, i) \
+		((ring) + 16 + 20 * RingEntries + 8 * ((unsigned) (i) % RingEntries))
+#define RingSize		(16 + 28 * RingEntries)
+
+// The following class defines an entry of the system call table: what
+// to call the system call in DEBUG output and statistics, what its
+// arguments are, and the routine that carries it out.
+//
+// Each letter of "signature" stands for one argument, from r4 on:
+//	'i' -- an integer, passed as is
+//	's' -- a null-terminated string, such as a file name, copied in
+//	'r' -- a buffer the call reads, copied in; its size is the
+//		   next argument
+//	'w' -- a buffer the call writes, copied out, as many bytes as the
+//		   call returns; its size is the next argument
+// A string or buffer that is not all in the program's memory makes the
+// call return EFAULT, and a negative size -1, without the routine
+// being called.  The routine gets the arguments, and, for a string or
+// buffer, the kernel's copy of it in "data".
+
+typedef int (*SyscallRoutine)(int *arg, char **data);
+
+class Syscall {
+  public:
+    int code;				// SC_*
+    const char *name;
+    const char *signature;		// One letter per argument
+    SyscallRoutine routine;
+};
+
+static const Syscall *FindSyscall(int code);
+
+//----------------------------------------------------------------------
+// Dispatch
+// 	Copy in the arguments of a system call, according to its signature,
+//	carry it out, copy out what it wrote, and return its result.  Does
+//	not return if the system call does not (Halt, Exit, MSG).
+//
+//	"call" -- the system call's table entry
+//	"arg" -- its arguments, r4 to r7
+//----------------------------------------------------------------------
+
+static int
+Dispatch(const Syscall *call, int *arg)
+{
+    AddrSpace *space = kernel->currentThread->space;
+    char name[PathNameMaxLen + 1];
+    char *data[4] = { NULL, NULL, NULL, NULL };
+    int result = 0, i;
+
+    for (i = 0; call->signature[i] != '\0' && result == 0; i++)
+	switch (call->signature[i]) {
+	  case 's':
+	    if (space->CopyInString(arg[i], name, PathNameMaxLen + 1)
+							!= NoException)
+		result = EFAULT;
+	    data[i] = name;
+	    break;
+	  case 'r':
+	  case 'w':
+	    if (arg[i + 1] < 0)
+		result = -1;
+	    else if (space->CheckRange(arg[i], arg[i + 1],
+				call->signature[i] == 'w') != NoException)
+		result = EFAULT;
+	    else {
+		data[i] = new char[arg[i + 1] + 1];
+		if (call->signature[i] == 'r')
+		    space->CopyIn(arg[i], data[i], arg[i + 1]);
+	    }
+	    break;
+	}
+
+    if (result == 0)
+	result = (*call->routine)(arg, data);
+
+    for (i = 0; call->signature[i] != '\0'; i++)
+	if ((call->signature[i] == 'r' || call->signature[i] == 'w')
+							&& data[i] != NULL) {
+	    if (call->signature[i] == 'w' && result > 0)
+		space->CopyOut(data[i], arg[i], result);
+	    delete [] data[i];
+	}
+    return result;
+}
+
+//----------------------------------------------------------------------
+// RingCall
+// 	Carry out one request taken from a program's IoRing, just as the
+//	system call it stands for would, and return what that would have
+//	returned.
+//
+//	"opcode", "fd", "vaddr", "size" -- the request
+//----------------------------------------------------------------------
+
+static int
+RingCall(int opcode, int fd, int vaddr, int size)
+{
+    int arg[4];
+
+    switch (opcode) {
+      case RingOpen:
+	arg[0] = vaddr;
+	return Dispatch(FindSyscall(SC_Open), arg);
+      case RingRead:
+      case RingWrite:
+	arg[0] = vaddr;
+	arg[1] = size;
+	arg[2] = fd;
+	return Dispatch(FindSyscall(opcode == RingRead ? SC_Read : SC_Write),
+									arg);
+      case RingClose:
+	arg[0] = fd;
+	return Dispatch(FindSyscall(SC_Close), arg);
+    }
+    return -1;
+}
+
+
+//----------------------------------------------------------------------
+// RingBatch
+// 	Carry out "count" requests from a program's IoRing that all read
+//	(or all write) the same file, one after the other, with a single
+//	Read (or Write) through a buffer of their own, as ReadV and WriteV
+//	do.  Each request's result is its share of what that returned.
+//	Return FALSE, doing nothing, if a request is bad; RingCall then
+//	carries them out one by one, and finds out which.
+//
+//	"space" -- the program's address space
+//	"request" -- the requests, as opcode, fd, vaddr, size, data
+//	"count" -- how many requests
+//	"result" -- where to put what each would have returned
+//----------------------------------------------------------------------
+
+static bool
+RingBatch(AddrSpace *space, int (*request)[5], int count, int *result)
+{
+    bool reading = (request[0][0] == RingRead);
+    int total = 0, done, i;
+    char *buffer;
+
+    for (i = 0; i < count; i++) {
+	if (request[i][3] < 0
+		|| space->CheckRange(request[i][2], request[i][3], reading)
+							!= NoException)
+	    return FALSE;
+	total += request[i][3];
+    }
+
+    buffer = new char[total + 1];
+    if (reading)
+	done = SysRead(buffer, total, request[0][1]);
+    else {
+	for (i = 0, total = 0; i < count; total += request[i][3], i++)
+	    space->CopyIn(request[i][2], buffer + total, request[i][3]);
+	done = SysWrite(buffer, total, request[0][1]);
+    }
+    for (i = 0, total = 0; i < count; i++) {
+	result[i] = (done < 0) ? done : min(request[i][3], done - total);
+	if (reading && result[i] > 0)
+	    space->CopyOut(buffer + total, request[i][2], result[i]);
+	if (done > 0)
+	    total += result[i];
+    }
+    delete [] buffer;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// RingEnter
+// 	Carry out, in order, the requests a program has added to its
+//	IoRing, posting a completion for each, until there are no more or
+//	there is no room for another completion.  Return how many requests
+//	were taken, or an error if the program has no usable ring.
+//
+//	A run of requests that read (or write) the same file is carried
+//	out by RingBatch, with one Read (or Write) in all: that is what
+//	makes a batch cheaper than as many system calls, which would each
+//	take the file's locks and go through the write-behind buffer.
+//
+//	"space" -- the program's address space
+//----------------------------------------------------------------------
+
+static int
+RingEnter(AddrSpace *space)
+{
+    int ring = space->GetRing();
+    int index[4];		// requestHead, requestTail,
+				// completionHead, completionTail
+    int request[RingEntries][5], result[RingEntries], completion[2];
+    int count, room, taken, i, j;
+
+    if (ring == -1)
+	return -1;
+    space->CopyIn(ring, (char *) index, sizeof(index));
+    for (i = 0; i < 4; i++)
+	index[i] = WordToHost(index[i]);
+    if (index[1] - index[0] < 0 || index[1] - index[0] > RingEntries
+		|| index[3] - index[2] < 0 || index[3] - index[2] > RingEntries)
+	return EINVAL;
+
+    room = min(index[1] - index[0], RingEntries - (index[3] - index[2]));
+    for (taken = 0; taken < room; taken += count) {
+	for (count = 0; taken + count < room; count++) {
+	    space->CopyIn(RingRequestAt(ring, index[0] + taken + count),
+			(char *) request[count], sizeof(request[count]));
+	    for (j = 0; j < 5; j++)
+		request[count][j] = WordToHost(request[count][j]);
+	    if (count > 0 && (request[count][0] != request[0][0]
+				|| request[count][1] != request[0][1]))
+		break;			// not part of the run
+	    if (request[0][0] != RingRead && request[0][0] != RingWrite) {
+		count++;		// a run of its own
+		break;
+	    }
+	}
+
+	if (count == 1 || !RingBatch(space, request, count, result))
+	    for (i = 0; i < count; i++)
+		result[i] = RingCall(request[i][0], request[i][1],
+					request[i][2], request[i][3]);
+	for (i = 0; i < count; i++) {
+	    DEBUG(dbgSys, "Ring request " << request[i][0] << " on "
+			<< request[i][1] << " returned " << result[i] << "\n");
+	    completion[0] = WordToHost(request[i][4]);
+	    completion[1] = WordToHost(result[i]);
+	    space->CopyOut((char *) completion,
+				RingCompletionAt(ring, index[3] + taken + i),
+				sizeof(completion));
+	}
+    }
+
+    index[0] = WordToHost(index[0] + taken);
+    index[3] = WordToHost(index[3] + taken);
+    space->CopyOut((char *) &index[0], ring, sizeof(int));
+    space->CopyOut((char *) &index[3], ring + 3 * sizeof(int), sizeof(int));
+    return taken;
+}
+
+//----------------------------------------------------------------------
+// The routines of the system call table, one per system call.  See
+// syscall.h for what each does, and Syscall for their arguments.
+//----------------------------------------------------------------------
+
+static int
+DoHalt(int *arg, char **data)
+{
+    SysHalt();
+    return 0;
+}
+
+static int
+DoExit(int *arg, char **data)
+{
+    DEBUG(dbgSys, "Program exit, return value " << arg[0] << "\n");
+    kernel->currentThread->space->CloseFiles();
+    kernel->currentThread->Finish();
+    return 0;
+}
+
+static int
+DoMSG(int *arg, char **data)
+{
+    cout << data[0] << endl;
+    SysHalt();
+    return 0;
+}
+
+static int
+DoAdd(int *arg, char **data)
+{
+    return SysAdd(arg[0], arg[1]);
+}
+
+static int
+DoCreate(int *arg, char **data)
+{
+    return SysCreate(data[0], arg[1]);
+}
+
+static int
+DoOpen(int *arg, char **data)
+{
+    return SysOpen(data[0]);
+}
+
+static int
+DoRead(int *arg, char **data)
+{
+    return SysRead(data[0], arg[1], arg[2]);
+}
+
+static int
+DoWrite(int *arg, char **data)
+{
+    return SysWrite(data[0], arg[1], arg[2]);
+}
+
+static int
+DoSeek(int *arg, char **data)
+{
+    return SysSeek(arg[0], arg[1]);
+}
+
+static int
+DoClose(int *arg, char **data)
+{
+    return SysClose(arg[0]);
+}
+
+static int
+DoPRead(int *arg, char **data)
+{
+    return SysPRead(data[0], arg[1], arg[2], arg[3]);
+}
+
+static int
+DoPWrite(int *arg, char **data)
+{
+    return SysPWrite(data[0], arg[1], arg[2], arg[3]);
+}
+
+// ReadV and WriteV copy their vector in themselves: it is "count" pairs
+// of words, the address of a buffer and its size.  The buffers are
+// copied in (or out) from their places in one kernel buffer, so that
+// the file sees a single Write (or Read).
+
+static int
+DoVector(int *arg, bool reading)
+{
+    AddrSpace *space = kernel->currentThread->space;
+    int vector[2 * MaxIoVecs];
+    int count = arg[1], total = 0, done, result, i;
+    char *buffer;
+
+    if (count < 0 || count > MaxIoVecs)
+	return -1;
+    if (space->CopyIn(arg[0], (char *) vector, 2 * sizeof(int) * count)
+							!= NoException)
+	return EFAULT;
+    for (i = 0; i < count; i++) {
+	vector[2 * i] = WordToHost(vector[2 * i]);
+	vector[2 * i + 1] = WordToHost(vector[2 * i + 1]);
+	if (vector[2 * i + 1] < 0)
+	    return -1;
+	if (space->CheckRange(vector[2 * i], vector[2 * i + 1], reading)
+							!= NoException)
+	    return EFAULT;
+	total += vector[2 * i + 1];
+    }
+
+    buffer = new char[total + 1];
+    if (reading) {
+	result = SysRead(buffer, total, arg[2]);
+	for (i = 0, done = 0; i < count && done < result; i++) {
+	    int n = min(vector[2 * i + 1], result - done);
+	    space->CopyOut(buffer + done, vector[2 * i], n);
+	    done += n;
+	}
+    } else {
+	for (i = 0, done = 0; i < count; done += vector[2 * i + 1], i++)
+	    space->CopyIn(vector[2 * i], buffer + done, vector[2 * i + 1]);
+	result = SysWrite(buffer, total, arg[2]);
+    }
+    delete [] buffer;
+    return result;
+}
+
+static int
+DoReadV(int *arg, char **data)
+{
+    return DoVector(arg, TRUE);
+}
+
+static int
+DoWriteV(int *arg, char **data)
+{
+    return DoVector(arg, FALSE);
+}
+
+static int
+DoFsync(int *arg, char **data)
+{
+    return SysFsync(arg[0]);
+}
+
+static int
+DoSync(int *arg, char **data)
+{
+    SysSync();
+    return 0;
+}
+
+// The whole ring is checked here, so that RingEnter cannot fault on it.
+
+static int
+DoRingSetup(int *arg, char **data)
+{
+    AddrSpace *space = kernel->currentThread->space;
+
+    if (space->CheckRange(arg[0], RingSize, TRUE) != NoException)
+	return EFAULT;
+    space->SetRing(arg[0]);
+    return 1;
+}
+
+static int
+DoRingEnter(int *arg, char **data)
+{
+    return RingEnter(kernel->currentThread->space);
+}
+
+static const Syscall syscalls[] = {
+    { SC_Halt,		"Halt",		"",	DoHalt },
+    { SC_Exit,		"Exit",		"i",	DoExit },
+    { SC_Create,	"Create",	"si",	DoCreate },
+    { SC_Open,		"Open",		"s",	DoOpen },
+    { SC_Read,		"Read",		"wii",	DoRead },
+    { SC_Write,		"Write",	"rii",	DoWrite },
+    { SC_Seek,		"Seek",		"ii",	DoSeek },
+    { SC_Close,		"Close",	"i",	DoClose },
+    { SC_Fsync,		"Fsync",	"i",	DoFsync },
+    { SC_Sync,		"Sync",		"",	DoSync },
+    { SC_PRead,		"PRead",	"wiii",	DoPRead },
+    { SC_PWrite,	"PWrite",	"riii",	DoPWrite },
+    { SC_ReadV,		"ReadV",	"iii",	DoReadV },
+    { SC_WriteV,	"WriteV",	"iii",	DoWriteV },
+    { SC_RingSetup,	"RingSetup",	"i",	DoRingSetup },
+    { SC_RingEnter,	"RingEnter",	"",	DoRingEnter },
+    { SC_Add,		"Add",		"ii",	DoAdd },
+    { SC_MSG,		"MSG",		"s",	DoMSG },
+};
+
+//----------------------------------------------------------------------
+// FindSyscall
+// 	Return the table entry of the system call "code", or NULL if there
+//	is no such system call.  The entries are indexed by code the first
+//	time through.
+//----------------------------------------------------------------------
+
+static const Syscall *
+FindSyscall(int code)
+{
+    static const Syscall *byCode[NumSyscallCodes];
+    static bool indexed = FALSE;
+
+    if (!indexed) {
+	for (unsigned int i = 0; i < sizeof(syscalls) / sizeof(Syscall); i++) {
+	    ASSERT(syscalls[i].code >= 0 && syscalls[i].code < NumSyscallCodes);
+	    byCode[syscalls[i].code] = &syscalls[i];
+	}
+	indexed = TRUE;
+    }
+    if (code < 0 || code >= NumSyscallCodes)
+	return NULL;
+    return byCode[code];
+}
+
 //----------------------------------------------------------------------
 // ExceptionHandler
 // 	Entry point into the Nachos kernel.  Called when a user program
@@ -44,6 +509,10 @@
 // If you are handling a system call, don't forget to increment the pc
 // before returning. (Or else you'll loop making the same system call forever!)
 //
+//	System calls are looked up in the table above, by code; Dispatch
+//	does the rest.  Each one is counted, with the ticks it took, in
+//	the statistics printed by -S.
+//
 //	"which" is the kind of exception.  The list of possible exceptions 
 //	is in machine.h.
 //----------------------------------------------------------------------
@@ -52,145 +521,43 @@ void
 ExceptionHandler(ExceptionType which)
 {
     int type = kernel->machine->ReadRegister(2);
-	int val;
-    int status, exit, threadID, programID;
-	DEBUG(dbgSys, "Received Exception " << which << " type: " << type << "\n");
+    const Syscall *call;
+    int arg[4], result, start;
+
+    DEBUG(dbgSys, "Received Exception " << which << " type: " << type << "\n");
     switch (which) {
-    case SyscallException:
-      	switch(type) {
-      	case SC_Halt:
-			DEBUG(dbgSys, "Shutdown, initiated by user program.\n");
-			SysHalt();
-                        cout<<"in exception\n";
-			ASSERTNOTREACHED();
-			break;
-		case SC_MSG:
-			DEBUG(dbgSys, "Message received.\n");
-			val = kernel->machine->ReadRegister(4);
-			{
-			char *msg = &(kernel->machine->mainMemory[val]);
-			cout << msg << endl;
-			}
-			SysHalt();
-			ASSERTNOTREACHED();
-			break;
-		//#ifdef FILESYS_STUB
-		//Add size integer for File System
-		case SC_Create: 
-			val = kernel->machine->ReadRegister(4);
-			{
-			char *filename = &(kernel->machine->mainMemory[val]);
-			int size = kernel->machine->ReadRegister(5);
-			cout<<"--Create----Size in exception is = "<<size<<endl;
-			//cout << filename << endl;
-			status = SysCreate(filename, size);
-			kernel->machine->WriteRegister(2, (int) status);
-			}
-			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
-			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
-			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
-			return;
-			ASSERTNOTREACHED();
-            break;
-		case SC_Open:
-			val = kernel->machine->ReadRegister(4);
-			{
-			char *filename = &(kernel->machine->mainMemory[val]); 
-			int FileId = SysOpen(filename);
-			cout<<"--OPEN in exec FileID = "<<FileId<<endl;
-			kernel->machine->WriteRegister(2, (int)FileId);
-			}
-			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
-			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg)+4);
-			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
-			return;
-			ASSERTNOTREACHED();
-			break;
-		case SC_Write:
-			val = kernel->machine->ReadRegister(4);
-			{
-			char *buffer = &(kernel->machine->mainMemory[val]);
-			int size = kernel->machine->ReadRegister(5);
-			cout<<"--Write in EXEC size  = "<< size << endl;
-			int FileId = kernel->machine->ReadRegister(6);
-			status = SysWrite(buffer, size, FileId);
-			kernel->machine->WriteRegister(2, (int) status);
-			}
-			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
-			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg)+4);
-			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
-			return;
-			ASSERTNOTREACHED();
-			break;
-		case SC_Read:
-			val = kernel->machine->ReadRegister(4);
-			{
-			int size = kernel->machine->ReadRegister(5);
-			cout << "--Read in exec size = "<<size<<endl; 
-			char *buffer = &(kernel->machine->mainMemory[val]);
-			int FileId = kernel->machine->ReadRegister(6);
-			status = SysRead(buffer, size, FileId);
-			kernel->machine->WriteRegister(2,  status);	
-			}
-			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
-			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg)+4);
-			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
-			return;
-			ASSERTNOTREACHED();
-			break;
-		case SC_Close:
-			{
-			int FileId = kernel->machine->ReadRegister(4);
-			status = SysClose(FileId);
-			cout << "CLOSE in EXEC" << endl;
-			kernel->machine->WriteRegister(2,  status);
-			}
-			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
-			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg)+4);
-			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
-			return;
-			ASSERTNOTREACHED();
-			break;
-		//#endif
-      	case SC_Add:
-			DEBUG(dbgSys, "Add " << kernel->machine->ReadRegister(4) << " + " << kernel->machine->ReadRegister(5) << "\n");
-			/* Process SysAdd Systemcall*/
-			int result;
-			result = SysAdd(/* int op1 */(int)kernel->machine->ReadRegister(4),
-			/* int op2 */(int)kernel->machine->ReadRegister(5));
-			DEBUG(dbgSys, "Add returning with " << result << "\n");
-			/* Prepare Result */
-			kernel->machine->WriteRegister(2, (int)result);	
-			/* Modify return point */
-			{
-	  		/* set previous programm counter (debugging only)*/
-	  		kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
-	  			
-			/* set programm counter to next instruction (all Instructions are 4 byte wide)*/
-	  		kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
-	  
-	 		/* set next programm counter for brach execution */
-	 		kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
-			}
-			cout << "result is " << result << "\n";	
-			return;	
-			ASSERTNOTREACHED();
-            break;
-		case SC_Exit:
-			DEBUG(dbgAddr, "Program exit\n");
-            val=kernel->machine->ReadRegister(4);
-            cout << "return value:" << val << endl;
-			kernel->currentThread->Finish();
-            break;
-      	default:
-			cerr << "Unexpected system call " << type << "\n";
-			break;
-		}
-		break;
-	default:
-		cerr << "Unexpected user mode exception " << (int)which << "\n";
-		break;
+      case SyscallException:
+	call = FindSyscall(type);
+	if (call == NULL) {
+	    cerr << "Unexpected system call " << type << "\n";
+	    break;
+	}
+	for (int i = 0; i < 4; i++)
+	    arg[i] = kernel->machine->ReadRegister(4 + i);
+	DEBUG(dbgSys, call->name << "(" << arg[0] << ", " << arg[1] << ", "
+			<< arg[2] << ", " << arg[3] << ")\n");
+	kernel->stats->syscallNames[type] = call->name;
+	kernel->stats->numSyscalls[type]++;
+	start = kernel->stats->totalTicks;
+
+	result = Dispatch(call, arg);
+
+	kernel->stats->syscallTicks[type] += kernel->stats->totalTicks - start;
+	DEBUG(dbgSys, call->name << " returned " << result << "\n");
+	kernel->machine->WriteRegister(2, result);
+
+	// advance the PC past the syscall instruction (all instructions
+	// are 4 bytes wide; PrevPCReg is for debugging only)
+	kernel->machine->WriteRegister(PrevPCReg,
+				kernel->machine->ReadRegister(PCReg));
+	kernel->machine->WriteRegister(PCReg,
+				kernel->machine->ReadRegister(PCReg) + 4);
+	kernel->machine->WriteRegister(NextPCReg,
+				kernel->machine->ReadRegister(PCReg) + 4);
+	return;
+      default:
+	cerr << "Unexpected user mode exception " << (int)which << "\n";
+	break;
     }
     ASSERTNOTREACHED();
 }
-
@@ -14,10 +14,19 @@
 #include "kernel.h"
 
 #include "synchconsole.h"
+#include "sectorcache.h"
+#include "journal.h"
+#include "inodetable.h"
 
 
 void SysHalt()
 {
+#ifdef FILESYS_STUB
+  kernel->sectorCache->Flush();	// Halt does not wait for the disk
+#else
+  kernel->inodeTable->Flush(0);	// data held back by write-behind
+  kernel->journal->Sync();	// Halt does not wait for the disk
+#endif
   kernel->interrupt->Halt();
 }
 
@@ -55,5 +64,25 @@ int SysRead(char *buffer, int size, int ID)
 {
 	return kernel->interrupt->ReadFromFileId(buffer, size, ID);
 }
+int SysSeek(int position, int ID)
+{
+	return kernel->interrupt->SeekFileId(position, ID);
+}
+int SysPRead(char *buffer, int size, int position, int ID)
+{
+	return kernel->interrupt->PReadFromFileId(buffer, size, position, ID);
+}
+int SysPWrite(char *buffer, int size, int position, int ID)
+{
+	return kernel->interrupt->PWriteToFileId(buffer, size, position, ID);
+}
+int SysFsync(int ID)
+{
+	return kernel->interrupt->FsyncFileId(ID);
+}
+void SysSync()
+{
+	kernel->interrupt->SyncFileSystem();
+}
 
 #endif /* ! __USERPROG_KSYSCALL_H__ */
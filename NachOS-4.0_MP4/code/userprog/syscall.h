@@ -34,6 +34,14 @@
 #define SC_ExecV	13
 #define SC_ThreadExit   14
 #define SC_ThreadJoin   15
+#define SC_Fsync	16
+#define SC_Sync		17
+#define SC_PRead	18
+#define SC_PWrite	19
+#define SC_ReadV	20
+#define SC_WriteV	21
+#define SC_RingSetup	22
+#define SC_RingEnter	23
 #define SC_Add		42
 #define SC_MSG		100
 
@@ -97,6 +105,9 @@ int Join(SpaceId id);
  * Note that the Nachos file system has a stub implementation, which
  * can be used to support these system calls if the regular Nachos
  * file system has not been implemented.
+ *
+ * A name or buffer that is not all inside the program's address space
+ * makes the call fail with EFAULT, before any of it is read or written.
  */
  
 /* A unique identifier for an open Nachos file. */
@@ -120,7 +131,10 @@ int Create(char *name, int size);
 int Remove(char *name);
 
 /* Open the Nachos file "name", and return an "OpenFileId" that can 
- * be used to read and write to the file.
+ * be used to read and write to the file: the lowest one not in use
+ * by the program, from 2 on.  Each Open starts at the beginning of
+ * the file, with a position of its own.  Return -1 if there is no
+ * such file, or the program has too many files open (see -fd).
  */
 OpenFileId Open(char *name);
 
@@ -139,15 +153,106 @@ int Write(char *buffer, int size, OpenFileId id);
 int Read(char *buffer, int size, OpenFileId id);
 
 /* Set the seek position of the open file "id"
- * to the byte "position".
+ * to the byte "position", which may be past the end of the file.
+ * Return "position" on success, -1 on failure.
  */
 int Seek(int position, OpenFileId id);
 
+/* Like Read and Write, but at the byte "position" of the open file,
+ * whatever its seek position is; the seek position is left as it was.
+ * Return the number of bytes read or written, -1 on failure.
+ */
+int PRead(char *buffer, int size, int position, OpenFileId id);
+int PWrite(char *buffer, int size, int position, OpenFileId id);
+
+/* A buffer of a vectored Read or Write.  In a user program, this is
+ * two words: the address of the buffer, and its size.
+ */
+typedef struct {
+    char *buffer;
+    int size;
+} IoVec;
+
+#define MaxIoVecs	16	/* most buffers one ReadV or WriteV takes */
+
+/* Like Read and Write, but with the "count" buffers of "vector", one
+ * after the other, in a single system call: WriteV writes the bytes
+ * of all of them at once, ReadV fills each in turn.  Return the number
+ * of bytes read or written, -1 on failure.
+ */
+int ReadV(IoVec *vector, int count, OpenFileId id);
+int WriteV(IoVec *vector, int count, OpenFileId id);
+
 /* Close the file, we're done reading and writing to it.
- * Return 1 on success, negative error code on failure
+ * Return 1 on success, negative error code on failure -- including
+ * when data written earlier could not be written out for want of disk
+ * space (the file is closed anyway).
  */
 int Close(OpenFileId id);
 
+/* Write out everything written to the open file "id" that is not on
+ * disk yet, along with the file system's own changes, and wait until
+ * it is there.  Writes are otherwise only written out some time later.
+ * Return 1 on success, negative error code on failure -- including
+ * when some of the data could not be written for want of disk space.
+ */
+int Fsync(OpenFileId id);
+
+/* Write out everything written to any file that is not on disk yet,
+ * and wait until it is there.
+ */
+void Sync();
+
+/* Open, Read, Write and Close can also be asked for in batches, through
+ * a ring the program shares with the kernel: the program adds requests
+ * at requestTail and calls RingEnter, which carries out all of them in
+ * one system call, in order, and adds a completion for each at
+ * completionTail.  The program takes completions from completionHead.
+ *
+ * Heads and tails only ever grow; the slot for index "i" is
+ * i % RingEntries.  The kernel moves requestHead and completionTail,
+ * the program the other two.
+ */
+#define RingEntries	16
+
+#define RingOpen	1	/* buffer holds the name; fd and size unused */
+#define RingRead	2
+#define RingWrite	3
+#define RingClose	4	/* buffer and size unused */
+
+typedef struct {
+    int opcode;		/* RingOpen, RingRead, RingWrite or RingClose */
+    OpenFileId fd;
+    char *buffer;
+    int size;
+    int data;		/* anything; handed back with the completion */
+} RingRequest;
+
+typedef struct {
+    int data;		/* the request's */
+    int result;		/* what Open, Read, Write or Close would return */
+} RingCompletion;
+
+typedef struct {
+    int requestHead;
+    int requestTail;
+    int completionHead;
+    int completionTail;
+    RingRequest requests[RingEntries];
+    RingCompletion completions[RingEntries];
+} IoRing;
+
+/* Share "ring" with the kernel, for RingEnter.  Its heads and tails
+ * should all be 0.  Return 1 on success, negative error code on failure.
+ */
+int RingSetup(IoRing *ring);
+
+/* Carry out the requests added to the ring since the last RingEnter,
+ * stopping early if there is no room left for their completions.
+ * Return the number of requests taken, negative error code on failure.
+ */
+int RingEnter();
+
 
 /* User-level thread operations: Fork and Yield.  To allow multiple
  * threads to run within a user program. 